@@ -1,13 +1,24 @@
 #include "SDL_manager.h"
-#include "SDL.h"
 #include <exception>
 #include <stdexcept>
-SdlManager::SdlManager() {
-	if (SDL_Init(SDL_INIT_EVERYTHING)) {
+SdlManager::SdlManager(Uint32 subsystems, const char* videoDriver) {
+	bool hasDriver = videoDriver && (subsystems & SDL_INIT_VIDEO);
+	if (SDL_Init(hasDriver ? subsystems & ~SDL_INIT_VIDEO : subsystems)) {
 		throw std::runtime_error{ SDL_GetError() };
 	}
+	if (hasDriver) {
+		if (SDL_VideoInit(videoDriver)) {
+			std::runtime_error error{ SDL_GetError() };
+			SDL_Quit();
+			throw error;
+		}
+		isVideoStarted = true;
+	}
 }
 
 SdlManager::~SdlManager() {
+	if (isVideoStarted) {
+		SDL_VideoQuit();
+	}
 	SDL_Quit();
 }
@@ -1,7 +1,12 @@
 #pragma once
+#include "SDL.h"
 class SdlManager { // wrapper for initializing/deinitializing SDL2 library
+private:
+	bool isVideoStarted = false; // video was started for a chosen driver, which SDL_Quit leaves running
 public:
-	SdlManager();
+	static constexpr Uint32 defaultSubsystems = SDL_INIT_VIDEO | SDL_INIT_EVENTS; // all a viewer needs; audio, joysticks and sensors only cost startup time and threads
+	explicit SdlManager(Uint32 subsystems = defaultSubsystems, const char* videoDriver = nullptr); // videoDriver "dummy" makes windows without a display, for headless runs
+	SdlManager(const SdlManager&) = delete;
+	SdlManager& operator=(const SdlManager&) = delete;
 	~SdlManager();
 };
-
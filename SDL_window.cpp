@@ -1,20 +1,33 @@
 #include "SDL_window.h"
+#include "bitmap_font.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
 #include <iostream>
 
-SdlWindow::SdlWindow(const std::string& name, size_t width, size_t height) {
-	this->width = width;
-	this->height = height;
-	has_target = false;
+constexpr double zoomStep = 1.25;
+constexpr int hudScale = 2; // screen pixels per font pixel
+constexpr int hudPadding = 6;
+constexpr std::chrono::milliseconds fpsWindow{ 500 };
+
+SdlWindow::SdlWindow(const std::string& name, size_t width, size_t height, bool isVsynced) : RenderTarget(width, height) {
+	SDL_SetHint(SDL_HINT_RENDER_BATCHING, "1");
 	window = SDL_CreateWindow(name.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width, height, 0);
 	if (!window) {
 		throw std::runtime_error{ SDL_GetError() };
 	}
-	renderer = SDL_CreateRenderer(window, 0, 0);
+	renderer = SDL_CreateRenderer(window, 0, isVsynced ? SDL_RENDERER_PRESENTVSYNC : 0);
 	if (!renderer) {
 		SDL_DestroyWindow(window);
 		throw std::runtime_error{ SDL_GetError() };
 	}
+	if (SDL_RenderTargetSupported(renderer)) {
+		frameCache = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, width, height);
+	}
+	if (frameCache) {
+		SDL_SetRenderTarget(renderer, frameCache);
+	}
 }
 
 void SdlWindow::DrawLine(int x0, int y0, int x1, int y1) {
@@ -39,6 +52,72 @@ void SdlWindow::DrawRectangle(int x0, int y0, int x1, int y1) {
 	updateTarget(x0, y0, x1, y1);
 }
 
+void SdlWindow::DrawLines(const std::vector<Line>& lines) {
+	if (lines.empty()) {
+		return;
+	}
+	Color current = lines.front().color;
+	SetDrawColor(current.r, current.g, current.b);
+	for (const auto& line : lines) {
+		int x0 = offset_x + line.x0 * scale;
+		int y0 = offset_y + line.y0 * scale;
+		int x1 = offset_x + line.x1 * scale;
+		int y1 = offset_y + line.y1 * scale;
+		if (x0 == x1 && y0 == y1) {
+			continue; // shorter than a pixel, the vertex covers it
+		}
+		if (line.color.r != current.r || line.color.g != current.g || line.color.b != current.b) {
+			current = line.color;
+			SetDrawColor(current.r, current.g, current.b);
+		}
+		SDL_RenderDrawLine(renderer, x0, y0, x1, y1);
+	}
+}
+
+void SdlWindow::DrawRectangles(const std::vector<Rectangle>& rectangles, Color color) {
+	rectBuffer.clear();
+	pointBuffer.clear();
+	pixelStamp.resize(static_cast<size_t>(width) * height);
+	if (++frameStamp == 0) {
+		std::fill(pixelStamp.begin(), pixelStamp.end(), 0);
+		frameStamp = 1;
+	}
+	for (const auto& rectangle : rectangles) {
+		SDL_Rect rect;
+		rect.x = offset_x + rectangle.x0 * scale;
+		rect.y = offset_y + rectangle.y0 * scale;
+		rect.h = (rectangle.y1 - rectangle.y0) * scale;
+		rect.w = (rectangle.x1 - rectangle.x0) * scale;
+		if (std::min(rect.h, rect.w) > 1) {
+			rectBuffer.push_back(rect);
+		} else if (rect.x >= 0 && rect.y >= 0 && rect.x < width && rect.y < height) {
+			unsigned& stamp = pixelStamp[static_cast<size_t>(rect.y) * width + rect.x];
+			if (stamp != frameStamp) {
+				stamp = frameStamp;
+				pointBuffer.push_back({ rect.x, rect.y });
+			}
+		}
+	}
+	SetDrawColor(color.r, color.g, color.b);
+	if (!rectBuffer.empty()) {
+		SDL_RenderDrawRects(renderer, rectBuffer.data(), static_cast<int>(rectBuffer.size()));
+	}
+	if (!pointBuffer.empty()) {
+		SDL_RenderDrawPoints(renderer, pointBuffer.data(), static_cast<int>(pointBuffer.size()));
+	}
+}
+
+void SdlWindow::DrawImage(const std::vector<uint32_t>& pixels) {
+	if (!imageTexture) {
+		imageTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+		if (!imageTexture) {
+			throw std::runtime_error{ SDL_GetError() };
+		}
+	}
+	SDL_UpdateTexture(imageTexture, nullptr, pixels.data(), width * sizeof(uint32_t));
+	SDL_RenderCopy(renderer, imageTexture, nullptr, nullptr);
+}
+
 void SdlWindow::SetDrawColor(unsigned char r, unsigned char g, unsigned char b) {
 	SDL_SetRenderDrawColor(renderer, r, g, b, 255);
 }
@@ -48,16 +127,110 @@ void SdlWindow::Clear() {
 }
 
 void SdlWindow::Update() {
-	SDL_RenderPresent(renderer);
-	if (has_target)
-	{
-		scale = std::min(width / ((target_max_x - target_min_x)), height / ((target_max_y - target_min_y)));
-		offset_x = -target_min_x * scale;
-		offset_x += (width - (target_max_x * scale + offset_x)) / 2;
-		offset_y = -target_min_y * scale;
-		offset_y += ((height - (target_max_y * scale + offset_y)) / 2);
+	TRACE_SCOPE("SdlWindow::Update");
+	if (is_hud_shown) {
+		drawHud();
+	}
+	Redisplay();
+	updateView();
+	++fpsFrames;
+	auto now = std::chrono::steady_clock::now();
+	if (now - fpsStart >= fpsWindow) {
+		fps = fpsFrames / std::chrono::duration<double>(now - fpsStart).count();
+		fpsStart = now;
+		fpsFrames = 0;
+	}
+}
+
+void SdlWindow::SetHudText(std::vector<std::string> lines) {
+	hudLines = std::move(lines);
+}
+
+void SdlWindow::SetHudShown(bool isShown) {
+	is_hud_shown = isShown;
+}
+
+bool SdlWindow::IsHudShown() const {
+	return is_hud_shown;
+}
+
+size_t SdlWindow::HudToggleCount() const {
+	return hudToggleCount;
+}
+
+void SdlWindow::SetDensityShown(bool isShown) {
+	if (is_density_shown != isShown) {
+		is_density_shown = isShown;
+		++viewVersion;
+	}
+}
+
+bool SdlWindow::IsDensityShown() const {
+	return is_density_shown;
+}
+
+bool SdlWindow::IsLayoutPaused() const {
+	return is_layout_paused;
+}
+
+double SdlWindow::FramesPerSecond() const {
+	return fps;
+}
+
+void SdlWindow::drawHud() {
+	if (!fontAtlas) {
+		constexpr int glyphCount = lastGlyph - firstGlyph + 1;
+		std::vector<Uint32> pixels(static_cast<size_t>(glyphCount) * glyphWidth * glyphHeight, 0);
+		for (int glyph = 0; glyph < glyphCount; ++glyph) {
+			const unsigned char* rows = GlyphRows(static_cast<char>(firstGlyph + glyph));
+			for (int y = 0; y < glyphHeight; ++y) {
+				for (int x = 0; x < glyphWidth; ++x) {
+					if (rows[y] & (1 << (glyphWidth - 1 - x))) {
+						pixels[static_cast<size_t>(y) * glyphCount * glyphWidth + glyph * glyphWidth + x] = 0xFFFFFFFF;
+					}
+				}
+			}
+		}
+		fontAtlas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, glyphCount * glyphWidth, glyphHeight);
+		if (!fontAtlas) {
+			return;
+		}
+		SDL_UpdateTexture(fontAtlas, nullptr, pixels.data(), glyphCount * glyphWidth * sizeof(Uint32));
+		SDL_SetTextureBlendMode(fontAtlas, SDL_BLENDMODE_BLEND);
+	}
+
+	size_t longest = 0;
+	for (const auto& line : hudLines) {
+		longest = std::max(longest, line.size());
+	}
+	int advance = (glyphWidth + 1) * hudScale;
+	int lineHeight = (glyphHeight + 3) * hudScale;
+	SDL_Rect background{ 0, 0, static_cast<int>(longest) * advance + 2 * hudPadding, static_cast<int>(hudLines.size()) * lineHeight + 2 * hudPadding };
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 176);
+	SDL_RenderFillRect(renderer, &background);
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+	for (size_t row = 0; row < hudLines.size(); ++row) {
+		int x = hudPadding;
+		int y = hudPadding + static_cast<int>(row) * lineHeight;
+		for (char c : hudLines[row]) {
+			SDL_Rect source{ GlyphIndex(c) * glyphWidth, 0, glyphWidth, glyphHeight };
+			SDL_Rect destination{ x, y, glyphWidth * hudScale, glyphHeight * hudScale };
+			SDL_RenderCopy(renderer, fontAtlas, &source, &destination);
+			x += advance;
+		}
 	}
-	has_target = false;
+}
+
+void SdlWindow::Redisplay() {
+	if (!frameCache) {
+		SDL_RenderPresent(renderer); // without a cache only a frame that was just drawn can be shown
+		return;
+	}
+	SDL_SetRenderTarget(renderer, nullptr);
+	SDL_RenderCopy(renderer, frameCache, nullptr, nullptr);
+	SDL_RenderPresent(renderer);
+	SDL_SetRenderTarget(renderer, frameCache);
 }
 
 bool SdlWindow::HasCloseRequest() {
@@ -66,17 +239,69 @@ bool SdlWindow::HasCloseRequest() {
 		switch (event.type) {
 		case SDL_QUIT:
 			return true;
+		case SDL_WINDOWEVENT:
+			if (event.window.event == SDL_WINDOWEVENT_EXPOSED) {
+				Redisplay();
+			}
+			break;
 		case SDL_KEYDOWN:
 			switch (event.key.keysym.scancode) {
 			case SDL_SCANCODE_ESCAPE:
 				return true;
+			case SDL_SCANCODE_HOME:
+				resetView();
+				break;
+			case SDL_SCANCODE_F3:
+				is_hud_shown = !is_hud_shown;
+				++hudToggleCount;
+				break;
+			case SDL_SCANCODE_F4:
+				SetDensityShown(!is_density_shown);
+				break;
+			case SDL_SCANCODE_SPACE:
+				is_layout_paused = !is_layout_paused;
+				break;
 			}
+			break;
+		case SDL_MOUSEWHEEL: {
+			int wheel_y = event.wheel.direction == SDL_MOUSEWHEEL_FLIPPED ? -event.wheel.y : event.wheel.y; // away from the user is positive either way
+			if (wheel_y == 0) { // horizontal scrolling
+				break;
+			}
+			int mouse_x;
+			int mouse_y;
+			SDL_GetMouseState(&mouse_x, &mouse_y);
+			zoomAt(wheel_y > 0 ? zoomStep : 1 / zoomStep, mouse_x, mouse_y);
+			break;
+		}
+		case SDL_MOUSEBUTTONDOWN:
+			is_dragging = event.button.button == SDL_BUTTON_LEFT;
+			break;
+		case SDL_MOUSEBUTTONUP:
+			is_dragging = false;
+			break;
+		case SDL_MOUSEMOTION:
+			if (is_dragging) {
+				pan_x -= event.motion.xrel / scale;
+				pan_y -= event.motion.yrel / scale;
+				++viewVersion;
+			}
+			break;
 		}
 	}
 	return false;
 }
 
 SdlWindow::~SdlWindow() {
+	if (imageTexture) {
+		SDL_DestroyTexture(imageTexture);
+	}
+	if (fontAtlas) {
+		SDL_DestroyTexture(fontAtlas);
+	}
+	if (frameCache) {
+		SDL_DestroyTexture(frameCache);
+	}
 	if (renderer) {
 		SDL_DestroyRenderer(renderer);
 	}
@@ -84,31 +309,3 @@ SdlWindow::~SdlWindow() {
 		SDL_DestroyWindow(window);
 	}
 }
-
-void SdlWindow::updateTarget(int minX, int minY, int maxX, int maxY)
-{
-	if (!has_target)
-	{
-		target_min_x = minX;
-		target_max_x = maxX;
-		target_min_y = minY;
-		target_max_y = maxY;
-	}
-	has_target = true;
-	if (target_min_x > minX)
-	{
-		target_min_x = minX;
-	}
-	if (target_max_x < maxX)
-	{
-		target_max_x = maxX;
-	}
-	if (target_min_y > minY)
-	{
-		target_min_y = minY;
-	}
-	if (target_max_y < maxY)
-	{
-		target_max_y = maxY;
-	}
-}
@@ -1,30 +1,50 @@
 #pragma once
 #include "SDL.h"
+#include "render_target.h"
+#include <chrono>
 #include <string>
-class SdlWindow { // window class containing all methods for drawing
+#include <vector>
+class SdlWindow : public RenderTarget { // window class containing all methods for drawing
 private:
 	SDL_Window* window;
 	SDL_Renderer* renderer;
-	int width;
-	int height;
-	int offset_x = 0;
-	int offset_y = 0;
-	double scale = 1.0;
-	double target_max_x;
-	double target_min_x;
-	double target_max_y;
-	double target_min_y;
-	bool has_target;
+	SDL_Texture* frameCache = nullptr; // frames are drawn here, so they can be shown again without redrawing
+	bool is_dragging = false;
+	std::vector<SDL_Rect> rectBuffer;
+	std::vector<SDL_Point> pointBuffer;
+	std::vector<unsigned> pixelStamp; // frame number per screen pixel, to put one point per pixel
+	unsigned frameStamp = 0;
+	bool is_hud_shown = false;
+	size_t hudToggleCount = 0;
+	std::vector<std::string> hudLines;
+	SDL_Texture* imageTexture = nullptr; // streaming texture for DrawImage
+	bool is_density_shown = false;
+	bool is_layout_paused = false;
+	SDL_Texture* fontAtlas = nullptr; // white glyphs of bitmap_font side by side, made on first use
+	std::chrono::steady_clock::time_point fpsStart = std::chrono::steady_clock::now();
+	size_t fpsFrames = 0;
+	double fps = 0;
 public:
-	SdlWindow(const std::string& name, size_t width = 800, size_t height = 600);
-	void DrawLine(int x0, int y0, int x1, int y1);
-	void DrawRectangle(int x0, int y0, int x1, int y1);
-	void SetDrawColor(unsigned char r, unsigned char g, unsigned char b);
-	void Clear();
-	void Update();
+	SdlWindow(const std::string& name, size_t width = 800, size_t height = 600, bool isVsynced = false); // a vsynced window's Update waits for the display
+	void DrawLine(int x0, int y0, int x1, int y1) override;
+	void DrawRectangle(int x0, int y0, int x1, int y1) override;
+	void DrawLines(const std::vector<Line>& lines) override; // changes color only between runs of different colors
+	void DrawRectangles(const std::vector<Rectangle>& rectangles, Color color) override; // one call, one point per pixel for collapsed ones
+	void DrawImage(const std::vector<uint32_t>& pixels) override;
+	void SetDrawColor(unsigned char r, unsigned char g, unsigned char b) override;
+	void Clear() override;
+	void Update() override;
+	void Redisplay(); // presents the last finished frame again
+	void SetHudText(std::vector<std::string> lines); // shown in the overlay from the next Update on
+	void SetHudShown(bool isShown);
+	bool IsHudShown() const; // F3 toggles the overlay
+	size_t HudToggleCount() const; // times F3 was pressed
+	void SetDensityShown(bool isShown);
+	bool IsDensityShown() const; // F4 switches between drawing the elements and the density heatmap
+	bool IsLayoutPaused() const; // Space pauses and resumes the layout
+	double FramesPerSecond() const; // frames presented per second, counted over about half a second
 	bool HasCloseRequest();
 	~SdlWindow();
 private:
-	void updateTarget(int minX, int minY, int maxX, int maxY);
+	void drawHud();
 };
-
@@ -2,47 +2,242 @@
 #include "SDL_manager.h"
 #include "SDL_window.h"
 #include "graph.h"
+#include "benchmark.h"
+#include "headless.h"
+#include "graph_generator.h"
+#include "frame_scheduler.h"
+#include "layout_runner.h"
+#include "process_memory.h"
+#include "trace.h"
+#include <atomic>
+#include <charconv>
 #include <chrono>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
 #include <thread>
+#include <vector>
 
-constexpr int frameTime = 33;
-constexpr double stableThreshold = 20.0;
+constexpr double defaultFramesPerSecond = 60;
+constexpr size_t densityVertexCount = 100000; // bigger graphs start in the density heatmap
 
-int main(int argC, char** argV) {
-	SdlManager manager{};
-	SdlWindow window{"graph demo", 800, 600};
-	std::string filename;
-	if (argC < 2) {
-		filename = "JSON_test_files/big_graph.json";
-	}
-	else {
-		filename = argV[1];
-	}
-	Graph demoGraph{ filename };
-	bool toExit = false;
-	auto lastUpdateTime = std::chrono::high_resolution_clock::now();
-	std::thread graphCalcThread{ [&demoGraph, &toExit]() {
-		double change = stableThreshold;
-		while (!toExit && change >= stableThreshold) {
-			change = demoGraph.ApplyForce();
-		} 
-	} 
+std::vector<std::string> HudLines(Graph& graph, const SdlWindow& window, const FrameScheduler& scheduler) {
+	Graph::Stats stats = graph.GetStats();
+	std::vector<std::string> lines;
+	std::ostringstream line;
+	auto next = [&lines, &line]() {
+		lines.push_back(line.str());
+		line.str({});
 	};
+	line << std::fixed << std::setprecision(1);
+	if (graph.IsLoading()) {
+		Graph::LoadProgress load = graph.GetLoadProgress();
+		line << "loading: " << load.fraction * 100 << "%, " << load.vertices << " vertices, " << load.edges << " edges";
+		next();
+	}
+	line << "render: " << window.FramesPerSecond() << " fps, " << scheduler.MissedFrames() << " missed";
+	next();
+	line << "layout: " << stats.iterationsPerSecond << " it/s, " << stats.iterations << " iterations" << (window.IsLayoutPaused() ? ", paused" : "");
+	next();
+	line << std::setprecision(2);
+	line << "last step: coulomb " << stats.coulombMs << " ms, centering " << stats.centeringMs << " ms";
+	next();
+	line << "           hooke " << stats.hookeMs << " ms, publish " << stats.publishMs << " ms";
+	next();
+	line << std::setprecision(3);
+	line << "lock wait: layout " << stats.layoutLockWaitMs << " ms, draw " << stats.drawLockWaitMs << " ms";
+	next();
+	line << "vertices: " << graph.VertexCount() << ", edges: " << graph.EdgeCount();
+	next();
+	line << std::setprecision(1);
+	line << "memory: " << ResidentMemoryBytes() / (1024.0 * 1024.0) << " MB";
+	next();
+	return lines;
+}
+
+int Usage(const char* program, const std::string& problem) { // returns the exit code for bad arguments
+	std::cerr << problem << "\nusage: " << program << " [map] [--vsync] [--bundle] [--video-driver driver] [--fps rate]\n"
+		<< "       " << program << " --benchmark [map] | --startup-benchmark [video driver] | --scaling-benchmark [shape] [vertices]\n"
+		<< "       " << program << " --headless map output [frames] | --generate shape vertices output [seed]\n";
+	return 1;
+}
+
+template<typename Number>
+bool ParseNumber(const char* text, Number& value) { // all of text, unlike std::sto*, and without exceptions
+	const char* end = text + std::char_traits<char>::length(text);
+	auto [last, error] = std::from_chars(text, end, value);
+	return error == std::errc{} && last == end && last != text;
+}
 
-	while (!(toExit = window.HasCloseRequest())) {
-		window.SetDrawColor(0, 0, 0);
-		window.Clear();
-		demoGraph.Draw(window);
+int main(int argC, char** argV) {
+	if (argC > 1 && std::string(argV[1]) == "--benchmark") {
+		RunBenchmark(argC > 2 ? argV[2] : "JSON_test_files/extra_big2.json");
+		return 0;
+	}
+	if (argC > 1 && std::string(argV[1]) == "--scaling-benchmark") {
+		std::string shape = argC > 2 ? argV[2] : "geometric";
+		size_t vertices = 2000;
+		if (argC > 3 && !ParseNumber(argV[3], vertices)) {
+			return Usage(argV[0], std::string{ "invalid vertex count " } + argV[3]);
+		}
+		try {
+			GraphGenerator::ParseShape(shape);
+		} catch (const std::runtime_error& error) {
+			return Usage(argV[0], error.what());
+		}
+		RunScalingBenchmark(shape, vertices);
+		return 0;
+	}
+	if (argC > 1 && std::string(argV[1]) == "--startup-benchmark") {
+		RunStartupBenchmark(argC > 2 ? argV[2] : nullptr);
+		return 0;
+	}
+	if (argC > 1 && std::string(argV[1]) == "--headless") {
+		int frames = 0;
+		if (argC < 4 || (argC > 4 && !ParseNumber(argV[4], frames))) {
+			return Usage(argV[0], argC < 4 ? "--headless needs a map and an output file" : std::string{ "invalid frame count " } + argV[4]);
+		}
+		RunHeadless(argV[2], argV[3], frames);
+		return 0;
+	}
+	if (argC > 1 && std::string(argV[1]) == "--generate") {
+		size_t vertices = 0;
+		uint64_t seed = 1;
+		if (argC < 5) {
+			return Usage(argV[0], "--generate needs a shape, a vertex count and an output file");
+		}
+		if (!ParseNumber(argV[3], vertices)) {
+			return Usage(argV[0], std::string{ "invalid vertex count " } + argV[3]);
+		}
+		if (argC > 5 && !ParseNumber(argV[5], seed)) {
+			return Usage(argV[0], std::string{ "invalid seed " } + argV[5]);
+		}
+		std::optional<GraphGenerator> generator;
+		try {
+			generator.emplace(GraphGenerator::ParseShape(argV[2]), vertices, seed);
+		} catch (const std::runtime_error& error) {
+			return Usage(argV[0], error.what());
+		}
+		size_t edges = generator->Write(argV[4]);
+		std::cout << "wrote " << vertices << " vertices and " << edges << " edges to " << argV[4] << '\n';
+		return 0;
+	}
+	std::string filename = "JSON_test_files/big_graph.json";
+	double framesPerSecond = defaultFramesPerSecond;
+	bool isVsynced = false;
+	bool isBundled = false;
+	const char* videoDriver = nullptr;
+	for (int i = 1; i < argC; ++i) {
+		std::string argument = argV[i];
+		if (argument == "--vsync") {
+			isVsynced = true;
+		}
+		else if (argument == "--bundle") {
+			isBundled = true;
+		}
+		else if (argument == "--video-driver" && i + 1 < argC) {
+			videoDriver = argV[++i];
+		}
+		else if (argument == "--fps" && i + 1 < argC) {
+			if (!ParseNumber(argV[++i], framesPerSecond) || framesPerSecond <= 0) {
+				return Usage(argV[0], std::string{ "invalid frame rate " } + argV[i]);
+			}
+		}
+		else {
+			filename = argument;
+		}
+	}
+	FrameScheduler scheduler{ framesPerSecond, isVsynced ? FrameScheduler::Mode::Vsync : FrameScheduler::Mode::Deadline };
+	scheduler.SetMissReporter([](size_t missedFrames, FrameScheduler::Clock::duration lateness) {
+		std::cerr << "missed " << missedFrames << " frame(s), " << std::chrono::duration<double, std::milli>(lateness).count() << " ms late\n";
+	});
+	TRACE_THREAD_NAME("render");
+	SdlManager manager{ SdlManager::defaultSubsystems, videoDriver };
+	SdlWindow window{"graph demo", 800, 600, isVsynced};
+	Graph demoGraph;
+	demoGraph.SetInterpolated(true);
+	demoGraph.SetLevelOfDetail(true);
+	std::exception_ptr loadError;
+	std::atomic<bool> hasLoadFailed{ false };
+	std::thread loader{ [&demoGraph, &filename, &loadError, &hasLoadFailed]() { // the window shows the graph as it arrives
+		TRACE_THREAD_NAME("loader");
+		try {
+			demoGraph.Load(filename);
+		}
+		catch (...) {
+			loadError = std::current_exception();
+			hasLoadFailed = true;
+		}
+	} };
+	bool isHudShownForLoad = !window.IsHudShown();
+	window.SetHudShown(true); // for the load progress
+	size_t loadHudToggles = window.HudToggleCount();
+	LayoutRunner layout{ demoGraph };
+	if (isBundled) {
+		layout.SetProgressCallback([&demoGraph](const LayoutRunner::Progress& progress) {
+			if (progress.isSettled) {
+				demoGraph.BundleEdges();
+			}
+		});
+	}
 
-		auto currentTime = std::chrono::high_resolution_clock::now();
-		if (currentTime - lastUpdateTime < std::chrono::milliseconds{ frameTime }) {
-			std::this_thread::sleep_for(std::chrono::milliseconds{ frameTime } - (currentTime - lastUpdateTime));
+	size_t drawnPositions = 0;
+	size_t drawnView = 0;
+	bool hasFrame = false;
+	bool drawnHud = false;
+	bool isLayoutStarted = false;
+	bool isLoaded = false;
+	while (!window.HasCloseRequest() && !hasLoadFailed) {
+		if (!isLayoutStarted && demoGraph.GetLoadProgress().areVerticesLoaded) { // edges join the layout as they are parsed
+			window.SetDensityShown(demoGraph.VertexCount() > densityVertexCount);
+			layout.Start();
+			isLayoutStarted = true;
+		}
+		if (!isLoaded && !demoGraph.IsLoading()) {
+			isLoaded = true;
+			if (isHudShownForLoad && window.HudToggleCount() == loadHudToggles) { // left alone if the user chose with F3 since
+				window.SetHudShown(false);
+			}
+		}
+		if (window.IsLayoutPaused() && !layout.IsPaused()) {
+			layout.Pause();
 		}
-		lastUpdateTime = std::chrono::high_resolution_clock::now();
-		window.Update();
+		else if (!window.IsLayoutPaused() && layout.IsPaused()) {
+			layout.Resume();
+		}
+		bool isChanged = !hasFrame || demoGraph.IsInterpolating() || demoGraph.PositionsVersion() != drawnPositions || window.ViewVersion() != drawnView;
+		if (isChanged || window.IsHudShown() || drawnHud) { // otherwise the last frame is still on screen
+			drawnPositions = demoGraph.PositionsVersion();
+			drawnView = window.ViewVersion();
+			drawnHud = window.IsHudShown();
+			hasFrame = true;
+			demoGraph.SetRenderMode(window.IsDensityShown() ? Graph::RenderMode::Density : Graph::RenderMode::Elements);
+			if (drawnHud) {
+				window.SetHudText(HudLines(demoGraph, window, scheduler));
+			}
+			window.SetDrawColor(0, 0, 0);
+			window.Clear();
+			demoGraph.Draw(window);
+			window.Update();
+			scheduler.FramePresented();
+		}
+		scheduler.WaitForNextFrame();
 	}
 
-	graphCalcThread.join();
+	layout.Cancel();
+	layout.Wait();
+	demoGraph.CancelLoad();
+	loader.join();
+	if (loadError) {
+		try {
+			std::rethrow_exception(loadError);
+		} catch (const std::exception& error) {
+			std::cerr << "could not load " << filename << ": " << error.what() << '\n';
+			return 1;
+		}
+	}
 
 	return 0;
 }
\ No newline at end of file
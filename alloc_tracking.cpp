@@ -0,0 +1,185 @@
+#include "alloc_tracking.h"
+#ifdef ENABLE_ALLOC_TRACKING
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace {
+	struct alignas(std::max_align_t) Header { // right in front of every block, so a free knows its size and subsystem
+		void* base; // what malloc returned
+		size_t size;
+		AllocTracking::Subsystem subsystem;
+	};
+
+	struct Totals {
+		std::atomic<size_t> allocations{ 0 };
+		std::atomic<size_t> bytes{ 0 };
+		std::atomic<size_t> liveBytes{ 0 };
+		std::atomic<size_t> peakBytes{ 0 };
+	};
+
+	Totals totals[static_cast<size_t>(AllocTracking::Subsystem::count)]; // constant-initialized, so usable before main
+	thread_local AllocTracking::Subsystem current = AllocTracking::Subsystem::Other;
+
+	void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t)) noexcept {
+		size_t padding = alignment > alignof(Header) ? alignment : 0;
+		void* base = std::malloc(sizeof(Header) + padding + size);
+		if (!base) {
+			return nullptr;
+		}
+		uintptr_t block = reinterpret_cast<uintptr_t>(base) + sizeof(Header);
+		block = (block + alignment - 1) / alignment * alignment;
+		Header* header = reinterpret_cast<Header*>(block) - 1;
+		header->base = base;
+		header->size = size;
+		header->subsystem = current;
+		Totals& counted = totals[static_cast<size_t>(current)];
+		counted.allocations.fetch_add(1, std::memory_order_relaxed);
+		counted.bytes.fetch_add(size, std::memory_order_relaxed);
+		size_t live = counted.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+		size_t peak = counted.peakBytes.load(std::memory_order_relaxed);
+		while (live > peak && !counted.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+		}
+		return header + 1;
+	}
+
+	void* AllocateOrThrow(size_t size, size_t alignment = alignof(std::max_align_t)) {
+		while (true) {
+			if (void* block = Allocate(size, alignment)) {
+				return block;
+			}
+			std::new_handler handler = std::get_new_handler();
+			if (!handler) {
+				throw std::bad_alloc{};
+			}
+			handler();
+		}
+	}
+
+	void Free(void* block) noexcept {
+		if (!block) {
+			return;
+		}
+		Header* header = static_cast<Header*>(block) - 1;
+		totals[static_cast<size_t>(header->subsystem)].liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+		std::free(header->base);
+	}
+}
+
+namespace AllocTracking {
+	Scope::Scope(Subsystem subsystem) :previous{ current } {
+		current = subsystem;
+	}
+
+	Scope::~Scope() {
+		current = previous;
+	}
+
+	Subsystem Current() {
+		return current;
+	}
+
+	Counts Get(Subsystem subsystem) {
+		const Totals& counted = totals[static_cast<size_t>(subsystem)];
+		return { counted.allocations.load(), counted.bytes.load(), counted.liveBytes.load(), counted.peakBytes.load() };
+	}
+
+	const char* Name(Subsystem subsystem) {
+		switch (subsystem) {
+		case Subsystem::Other:
+			return "other";
+		case Subsystem::Json:
+			return "json";
+		case Subsystem::Load:
+			return "load";
+		case Subsystem::Layout:
+			return "layout";
+		case Subsystem::Draw:
+			return "draw";
+		default:
+			return "unknown";
+		}
+	}
+}
+
+void* operator new(size_t size) {
+	return AllocateOrThrow(size);
+}
+
+void* operator new[](size_t size) {
+	return AllocateOrThrow(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	return Allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return Allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+	return AllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+	return AllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return Allocate(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return Allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* block) noexcept {
+	Free(block);
+}
+
+void operator delete[](void* block) noexcept {
+	Free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+	Free(block);
+}
+
+void operator delete[](void* block, size_t) noexcept {
+	Free(block);
+}
+
+void operator delete(void* block, const std::nothrow_t&) noexcept {
+	Free(block);
+}
+
+void operator delete[](void* block, const std::nothrow_t&) noexcept {
+	Free(block);
+}
+
+void operator delete(void* block, std::align_val_t) noexcept {
+	Free(block);
+}
+
+void operator delete[](void* block, std::align_val_t) noexcept {
+	Free(block);
+}
+
+void operator delete(void* block, size_t, std::align_val_t) noexcept {
+	Free(block);
+}
+
+void operator delete[](void* block, size_t, std::align_val_t) noexcept {
+	Free(block);
+}
+
+void operator delete(void* block, std::align_val_t, const std::nothrow_t&) noexcept {
+	Free(block);
+}
+
+void operator delete[](void* block, std::align_val_t, const std::nothrow_t&) noexcept {
+	Free(block);
+}
+#endif
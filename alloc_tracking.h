@@ -0,0 +1,50 @@
+#pragma once
+// Allocation accounting, compiled in only when ENABLE_ALLOC_TRACKING is defined:
+//
+//     ALLOC_SCOPE(AllocTracking::Subsystem::Layout); // charges the enclosing block's allocations to the layout
+//
+// Replaces the global operator new and delete, so every allocation of the program is counted, by default as Other.
+// Frees are charged to the subsystem that allocated the block, wherever they happen.
+#include <cstddef>
+
+namespace AllocTracking {
+	enum class Subsystem {
+		Other,
+		Json, // DOM parsing
+		Load, // building the graph from the file
+		Layout,
+		Draw,
+		count
+	};
+
+	struct Counts {
+		size_t allocations = 0;
+		size_t bytes = 0; // allocated in total
+		size_t liveBytes = 0; // allocated and not yet freed
+		size_t peakBytes = 0; // most liveBytes so far
+	};
+}
+
+#ifdef ENABLE_ALLOC_TRACKING
+namespace AllocTracking {
+	class Scope { // charges the calling thread's allocations to subsystem until it ends
+	private:
+		Subsystem previous;
+	public:
+		explicit Scope(Subsystem subsystem);
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+		~Scope();
+	};
+
+	Subsystem Current(); // of the calling thread
+	Counts Get(Subsystem subsystem);
+	const char* Name(Subsystem subsystem);
+}
+
+#define ALLOC_CONCAT_INNER(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_INNER(a, b)
+#define ALLOC_SCOPE(subsystem) AllocTracking::Scope ALLOC_CONCAT(allocScope, __LINE__){ subsystem }
+#else
+#define ALLOC_SCOPE(subsystem) ((void)0)
+#endif
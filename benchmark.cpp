@@ -0,0 +1,362 @@
+#include "benchmark.h"
+#include "SDL_manager.h"
+#include "alloc_tracking.h"
+#include "SDL_window.h"
+#include "software_canvas.h"
+#include "thread_pool.h"
+#include "graph.h"
+#include "graph_generator.h"
+#include "json.h"
+#include "json_lines.h"
+#include "json_writer.h"
+#include "mapped_file.h"
+#include "perf_counters.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <vector>
+
+namespace {
+	constexpr int measuredFrames = 200;
+	constexpr int bigFrames = 10; // for frames that take a large part of a second
+	constexpr int startupRuns = 5; // SDL starts quickly, so the median of a few runs is reported
+	constexpr int countedSteps = 10; // layout steps the counters are read over
+	constexpr int countedFrames = 20;
+	constexpr int warmupSteps = 3; // until Publish has a retired snapshot to reuse
+	constexpr int scalingSteps = 5; // layout steps timed per run, the median of each phase is reported
+	constexpr size_t strongSizes = 3; // strong scaling runs on the base size and this many doublings of it, minus one
+	constexpr double efficiencyThreshold = 0.5; // phases below this parallel efficiency are flagged
+	constexpr uint64_t scalingSeed = 1;
+	constexpr size_t linesBytes = 16 << 20; // JSON Lines text timed by the LoadLines benchmark, the map's elements repeated up to this size
+	constexpr size_t phaseCount = 4;
+	const char* const phaseNames[phaseCount] = { "coulomb", "centering", "hooke", "publish" }; // as in Graph::Stats
+
+	template<typename Action>
+	double MeasureMs(Action action) {
+		auto start = std::chrono::steady_clock::now();
+		action();
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	template<typename DrawAction>
+	double MeasureFrameMs(RenderTarget& target, DrawAction draw, int frameCount = measuredFrames) { // mean time of Clear + draw + Update
+		auto frame = [&target, &draw]() {
+			target.SetDrawColor(0, 0, 0);
+			target.Clear();
+			draw(target);
+			target.Update();
+		};
+		for (int i = 0; i < std::max(1, frameCount / 20); ++i) { // warmup, also fits the view
+			frame();
+		}
+		return MeasureMs([&frame, frameCount]() {
+			for (int i = 0; i < frameCount; ++i) {
+				frame();
+			}
+		}) / frameCount;
+	}
+
+	template<typename Action>
+	PerfCounters::Values Count(const PerfCounters& counters, Action action) {
+		auto before = counters.Read();
+		action();
+		return counters.Read() - before;
+	}
+
+	void PrintPerElement(const PerfCounters& counters, const char* region, const PerfCounters::Values& values, double elements) {
+		std::cout << region << ':';
+		for (size_t event = 0; event < PerfCounters::eventCount; ++event) {
+			if (counters.IsAvailable(static_cast<PerfCounters::Event>(event))) {
+				std::cout << ' ' << values[event] / elements << ' ' << PerfCounters::Name(static_cast<PerfCounters::Event>(event)) << ',';
+			}
+		}
+		if (values[PerfCounters::Cycles] > 0) {
+			std::cout << " IPC " << static_cast<double>(values[PerfCounters::Instructions]) / values[PerfCounters::Cycles];
+		}
+		std::cout << '\n';
+	}
+
+	void PrintCounters(const PerfCounters& counters, const std::string& filename) {
+		if (!counters.IsAnyAvailable()) {
+			std::cout << "hardware counters unavailable: " << counters.Error() << '\n';
+			return;
+		}
+		if (!counters.Error().empty()) {
+			std::cout << "some hardware counters unavailable: " << counters.Error() << '\n';
+		}
+		// Parsing and building the graph are interleaved in Graph's loader, so parsing is counted on its own as a
+		// whole-document Json::Load of the same file and building as the loader's total.
+		MappedFile file(filename);
+		auto parse = Count(counters, [&file]() { Json::Load(file.View()); });
+		std::optional<Graph> counted;
+		auto build = Count(counters, [&counted, &filename]() { counted.emplace(filename); });
+		double vertices = static_cast<double>(counted->VertexCount());
+		double edges = static_cast<double>(counted->EdgeCount());
+
+		PerfCounters::Values phases[4] = {};
+		auto phaseStart = counters.Read();
+		counted->SetPhaseCallback([&counters, &phases, &phaseStart](Graph::LayoutPhase phase) {
+			auto now = counters.Read();
+			phases[static_cast<size_t>(phase)] += now - phaseStart;
+			phaseStart = now;
+		});
+		for (int i = 0; i < countedSteps; ++i) {
+			phaseStart = counters.Read();
+			counted->ApplyForce();
+		}
+		counted->SetPhaseCallback(nullptr);
+
+		SoftwareCanvas drawCanvas{ 800, 600 };
+		MeasureFrameMs(drawCanvas, [&counted](RenderTarget& target) { counted->Draw(target); }, 1); // fits the view
+		auto draw = Count(counters, [&drawCanvas, &counted]() {
+			for (int i = 0; i < countedFrames; ++i) {
+				drawCanvas.SetDrawColor(0, 0, 0);
+				drawCanvas.Clear();
+				counted->Draw(drawCanvas);
+				drawCanvas.Update();
+			}
+		});
+
+		std::cout << std::setprecision(3);
+		PrintPerElement(counters, "parse, per byte", parse, static_cast<double>(file.View().size()));
+		PrintPerElement(counters, "build, per vertex and edge", build, vertices + edges);
+		PrintPerElement(counters, "repulsion, per vertex pair", phases[static_cast<size_t>(Graph::LayoutPhase::Coulomb)], countedSteps * std::max(1.0, vertices * (vertices - 1) / 2)); // Coulomb takes each pair once
+		PrintPerElement(counters, "springs, per edge end", phases[static_cast<size_t>(Graph::LayoutPhase::Hooke)], countedSteps * 2 * std::max(1.0, edges));
+		PrintPerElement(counters, "draw (software canvas), per edge", draw, countedFrames * std::max(1.0, edges));
+	}
+
+	void PrintLinesThroughput(const std::string& filename) { // Json::LoadLines over the map's vertices and edges, one per line
+		MappedFile file(filename);
+		Json::Document document = Json::Load(file.View());
+		std::string text;
+		do {
+			size_t before = text.size();
+			for (const char* key : { "points", "lines" }) {
+				for (const auto& element : document.GetRoot().AsMap().at(key).AsArray()) {
+					Json::Writer(text).Value(element);
+					text += '\n';
+				}
+			}
+			if (text.size() == before) {
+				return;
+			}
+		} while (text.size() < linesBytes);
+		for (bool isOrdered : { true, false }) {
+			Json::LinesOptions options;
+			options.ordered = isOrdered;
+			size_t count = 0;
+			double ms = MeasureMs([&text, &options, &count]() { count = Json::LoadLines(text, [](size_t, Json::Document) {}, options); });
+			std::cout << "LoadLines, " << (isOrdered ? "ordered" : "unordered") << ": " << count << " lines in " << ms << " ms, "
+				<< text.size() / 1e6 / (ms / 1000) << " MB/s\n";
+		}
+	}
+
+	struct PhaseTimes {
+		double ms[phaseCount] = {};
+	};
+
+	PhaseTimes TimeLayout(const std::string& filename, size_t threads) { // median time of every phase over a few steps
+		Graph graph{ filename };
+		graph.SetLayoutThreadCount(threads);
+		graph.ApplyForce(); // warmup
+		std::vector<double> samples[phaseCount];
+		for (int i = 0; i < scalingSteps; ++i) {
+			graph.ApplyForce();
+			Graph::Stats stats = graph.GetStats();
+			double step[phaseCount] = { stats.coulombMs, stats.centeringMs, stats.hookeMs, stats.publishMs };
+			for (size_t phase = 0; phase < phaseCount; ++phase) {
+				samples[phase].push_back(step[phase]);
+			}
+		}
+		PhaseTimes result;
+		for (size_t phase = 0; phase < phaseCount; ++phase) {
+			std::nth_element(samples[phase].begin(), samples[phase].begin() + scalingSteps / 2, samples[phase].end());
+			result.ms[phase] = samples[phase][scalingSteps / 2];
+		}
+		return result;
+	}
+
+	double PhaseWork(size_t phase, size_t vertices, size_t edges) { // operations a phase does per step, for comparing graph sizes
+		return phase == 0 ? static_cast<double>(vertices) * (vertices - 1) : phase == 2 ? 2.0 * edges : static_cast<double>(vertices);
+	}
+
+	// Prints one row per thread count: every phase's time and its efficiency against one thread, work per time per
+	// thread, which covers strong scaling (same graph) and weak scaling (graph growing with the threads) alike.
+	void PrintScaling(const std::vector<size_t>& threadCounts, const std::vector<PhaseTimes>& times, const std::vector<size_t>& vertices, const std::vector<size_t>& edges) {
+		std::cout << std::setw(8) << "threads" << std::setw(10) << "vertices";
+		for (const char* name : phaseNames) {
+			std::cout << std::setw(22) << name;
+		}
+		std::cout << '\n';
+		for (size_t run = 0; run < threadCounts.size(); ++run) {
+			std::cout << std::setw(8) << threadCounts[run] << std::setw(10) << vertices[run];
+			for (size_t phase = 0; phase < phaseCount; ++phase) {
+				double base = PhaseWork(phase, vertices[0], edges[0]) / times[0].ms[phase];
+				double rate = PhaseWork(phase, vertices[run], edges[run]) / times[run].ms[phase];
+				double efficiency = rate / (base * threadCounts[run] / threadCounts[0]);
+				std::ostringstream cell;
+				cell << std::fixed << std::setprecision(3) << times[run].ms[phase] << " ms " << std::setprecision(0) << efficiency * 100 << '%' << (efficiency < efficiencyThreshold ? " !" : "  ");
+				std::cout << std::setw(22) << cell.str();
+			}
+			std::cout << '\n';
+		}
+	}
+
+#ifdef ENABLE_ALLOC_TRACKING
+	void PrintAllocations(const std::string& filename) { // loads the map again and shows what every subsystem allocated for it
+		using AllocTracking::Subsystem;
+		AllocTracking::Counts before[static_cast<size_t>(Subsystem::count)];
+		for (size_t i = 0; i < std::size(before); ++i) {
+			before[i] = AllocTracking::Get(static_cast<Subsystem>(i));
+		}
+		{
+			MappedFile file(filename);
+			Json::Load(file.View());
+		}
+		Graph graph{ filename };
+		for (int i = 0; i < warmupSteps; ++i) {
+			graph.ApplyForce();
+		}
+		auto beforeSteps = AllocTracking::Get(Subsystem::Layout);
+		for (int i = 0; i < countedSteps; ++i) {
+			graph.ApplyForce();
+		}
+		auto afterSteps = AllocTracking::Get(Subsystem::Layout);
+		for (size_t i = 0; i < std::size(before); ++i) {
+			auto now = AllocTracking::Get(static_cast<Subsystem>(i));
+			std::cout << "allocations, " << AllocTracking::Name(static_cast<Subsystem>(i)) << ": " << now.allocations - before[i].allocations << " blocks, "
+				<< now.bytes - before[i].bytes << " bytes, peak " << now.peakBytes << " bytes live\n";
+		}
+		std::cout << "allocations per steady layout step: " << static_cast<double>(afterSteps.allocations - beforeSteps.allocations) / countedSteps << " blocks, "
+			<< static_cast<double>(afterSteps.bytes - beforeSteps.bytes) / countedSteps << " bytes\n";
+	}
+#endif
+}
+
+void RunBenchmark(const std::string& filename) {
+	PerfCounters counters; // before anything starts the shared pool, so its workers are counted too
+	SdlManager manager{};
+	SdlWindow window{ "graph benchmark", 800, 600 };
+	std::optional<Graph> graph;
+	double loadMs = MeasureMs([&graph, &filename]() { graph.emplace(filename); });
+	std::cout << filename << '\n';
+	std::cout << "load: " << loadMs << " ms\n";
+
+	double perCallMs = MeasureFrameMs(window, [&graph](RenderTarget& target) { graph->DrawPerCall(target); });
+	double batchedMs = MeasureFrameMs(window, [&graph](RenderTarget& target) { graph->Draw(target); });
+	std::cout << "frame, per-call draw: " << perCallMs << " ms\n";
+	std::cout << "frame, batched draw: " << batchedMs << " ms (" << perCallMs / batchedMs << "x)\n";
+
+	SoftwareCanvas canvas{ 800, 600 };
+	SoftwareCanvas smoothCanvas{ 800, 600, true };
+	double softwareMs = MeasureFrameMs(canvas, [&graph](RenderTarget& target) { graph->Draw(target); });
+	double smoothMs = MeasureFrameMs(smoothCanvas, [&graph](RenderTarget& target) { graph->Draw(target); });
+	std::cout << "frame, software canvas: " << softwareMs << " ms, antialiased: " << smoothMs << " ms\n";
+
+	SoftwareCanvas bigCanvas{ 3840, 2160, true };
+	bigCanvas.SetThreadCount(1);
+	double serialMs = MeasureFrameMs(bigCanvas, [&graph](RenderTarget& target) { graph->Draw(target); }, bigFrames);
+	bigCanvas.SetThreadCount(0);
+	double tiledMs = MeasureFrameMs(bigCanvas, [&graph](RenderTarget& target) { graph->Draw(target); }, bigFrames);
+	std::cout << "frame, 3840x2160 antialiased, one thread: " << serialMs << " ms, tiled on every core: " << tiledMs << " ms (" << serialMs / tiledMs << "x)\n";
+	PrintLinesThroughput(filename);
+
+#ifdef ENABLE_ALLOC_TRACKING
+	PrintAllocations(filename);
+#endif
+	PrintCounters(counters, filename);
+}
+
+void RunStartupBenchmark(const char* videoDriver) {
+	struct Setup {
+		const char* name;
+		Uint32 subsystems;
+	};
+	const Setup setups[] = { { "every subsystem", SDL_INIT_EVERYTHING }, { "video and events", SdlManager::defaultSubsystems } };
+	std::cout << "video driver: " << (videoDriver ? videoDriver : "default") << '\n';
+	for (const auto& setup : setups) {
+		std::vector<double> initMs;
+		std::vector<double> windowMs;
+		std::vector<double> frameMs;
+		for (int run = 0; run < startupRuns; ++run) {
+			std::optional<SdlManager> manager;
+			std::optional<SdlWindow> window;
+			initMs.push_back(MeasureMs([&manager, &setup, videoDriver]() { manager.emplace(setup.subsystems, videoDriver); }));
+			windowMs.push_back(MeasureMs([&window]() { window.emplace("startup benchmark", 800, 600); }));
+			frameMs.push_back(MeasureMs([&window]() {
+				window->SetDrawColor(0, 0, 0);
+				window->Clear();
+				window->Update();
+			}));
+			window.reset();
+		}
+		auto median = [](std::vector<double>& values) {
+			std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+			return values[values.size() / 2];
+		};
+		double init = median(initMs);
+		double window = median(windowMs);
+		double frame = median(frameMs);
+		std::cout << setup.name << ": init " << init << " ms, window " << window << " ms, first frame " << frame << " ms, total " << init + window + frame << " ms\n";
+	}
+}
+
+void RunScalingBenchmark(const std::string& shape, size_t baseVertices) {
+	GraphGenerator::Shape parsedShape = GraphGenerator::ParseShape(shape);
+	size_t cores = ThreadPool::Shared().Concurrency();
+	std::vector<size_t> threadCounts;
+	for (size_t threads = 1; threads < cores; threads *= 2) {
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(cores);
+
+	std::vector<std::filesystem::path> files;
+	auto removeFiles = [&files]() {
+		for (const auto& file : files) {
+			std::error_code error;
+			std::filesystem::remove(file, error);
+		}
+	};
+	auto generate = [&files, parsedShape, &shape](size_t vertices, size_t& edges) { // into the temporary directory, removed at the end
+		files.push_back(std::filesystem::temp_directory_path() / ("scaling_" + shape + "_" + std::to_string(vertices) + ".json"));
+		edges = GraphGenerator{ parsedShape, vertices, scalingSeed }.Write(files.back().string());
+		return files.back().string();
+	};
+	try {
+		std::cout << "layout scaling on " << shape << " graphs, " << cores << " threads, efficiency below " << efficiencyThreshold * 100 << "% marked !\n";
+		for (size_t size = 0; size < strongSizes; ++size) {
+			size_t vertices = baseVertices << size;
+			size_t edges = 0;
+			std::string filename = generate(vertices, edges);
+			std::vector<PhaseTimes> times;
+			for (size_t threads : threadCounts) {
+				times.push_back(TimeLayout(filename, threads));
+			}
+			std::cout << "strong scaling, " << vertices << " vertices, " << edges << " edges:\n";
+			PrintScaling(threadCounts, times, std::vector<size_t>(threadCounts.size(), vertices), std::vector<size_t>(threadCounts.size(), edges));
+		}
+
+		// Coulomb's law takes most of a step and grows with the square of the vertices, so the graph grows with the
+		// square root of the threads to keep its work per thread the same.
+		std::vector<PhaseTimes> times;
+		std::vector<size_t> vertices;
+		std::vector<size_t> edges;
+		for (size_t threads : threadCounts) {
+			vertices.push_back(static_cast<size_t>(std::lround(baseVertices * std::sqrt(static_cast<double>(threads)))));
+			edges.push_back(0);
+			times.push_back(TimeLayout(generate(vertices.back(), edges.back()), threads));
+		}
+		std::cout << "weak scaling, work per thread of " << baseVertices << " vertices:\n";
+		PrintScaling(threadCounts, times, vertices, edges);
+	} catch (...) {
+		removeFiles();
+		throw;
+	}
+	removeFiles();
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <string>
+
+void RunBenchmark(const std::string& filename); // loads the map and prints load time, frame times of both draw paths and JSON Lines throughput
+void RunStartupBenchmark(const char* videoDriver = nullptr); // prints how long SDL takes to start and show a first frame with every subsystem and with the default ones
+// Times the layout phases on generated graphs of the given shape for 1, 2, 4, ... threads up to every core, and prints
+// strong scaling for a few sizes from baseVertices up and weak scaling from baseVertices, flagging poor efficiency.
+void RunScalingBenchmark(const std::string& shape = "geometric", size_t baseVertices = 2000);
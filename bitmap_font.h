@@ -0,0 +1,9 @@
+#pragma once
+constexpr int glyphWidth = 5;
+constexpr int glyphHeight = 7;
+constexpr char firstGlyph = ' ';
+constexpr char lastGlyph = 'Z';
+
+// 5x7 pixel font covering ' ' to 'Z'; lowercase letters are drawn as uppercase, other characters as blanks
+int GlyphIndex(char c); // position of c's glyph among the lastGlyph - firstGlyph + 1 glyphs
+const unsigned char* GlyphRows(char c); // glyphHeight rows from top to bottom, bit 4 being the leftmost pixel
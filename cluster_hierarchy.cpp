@@ -0,0 +1,158 @@
+#include "cluster_hierarchy.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	uint64_t PairKey(uint32_t a, uint32_t b) {
+		return static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b);
+	}
+
+	std::vector<ClusterHierarchy::Link> MergeLinks(std::vector<std::pair<uint64_t, size_t>>& keyed) { // sums counts of equal cluster pairs
+		std::sort(keyed.begin(), keyed.end());
+		std::vector<ClusterHierarchy::Link> links;
+		for (const auto& [key, count] : keyed) {
+			uint32_t from = static_cast<uint32_t>(key >> 32);
+			uint32_t to = static_cast<uint32_t>(key);
+			if (!links.empty() && links.back().from == from && links.back().to == to) {
+				links.back().count += count;
+			} else {
+				links.push_back({ from, to, count });
+			}
+		}
+		std::stable_sort(links.begin(), links.end(), [](const auto& lhs, const auto& rhs) { return lhs.count < rhs.count; });
+		return links;
+	}
+}
+
+void ClusterHierarchy::Build(const std::vector<RenderTarget::Point>& positions, const std::vector<std::pair<size_t, size_t>>& edges, size_t levelCount) {
+	levels.assign(levelCount, {});
+	leafOf.assign(positions.size(), 0);
+	if (positions.empty() || levelCount == 0) {
+		levels.clear();
+		return;
+	}
+	double minX = positions.front().x;
+	double minY = positions.front().y;
+	double maxX = minX;
+	double maxY = minY;
+	for (const auto& point : positions) {
+		minX = std::min(minX, point.x);
+		minY = std::min(minY, point.y);
+		maxX = std::max(maxX, point.x);
+		maxY = std::max(maxY, point.y);
+	}
+	side = std::max({ maxX - minX, maxY - minY, 1e-9 });
+
+	// cell of every vertex on the finest level, as y * cells + x
+	uint32_t cells = 1u << (levelCount - 1);
+	std::vector<std::pair<uint64_t, uint32_t>> keyed(positions.size());
+	for (size_t i = 0; i < positions.size(); ++i) {
+		uint64_t x = std::min<uint64_t>(cells - 1, static_cast<uint64_t>((positions[i].x - minX) / side * cells));
+		uint64_t y = std::min<uint64_t>(cells - 1, static_cast<uint64_t>((positions[i].y - minY) / side * cells));
+		keyed[i] = { y << 32 | x, static_cast<uint32_t>(i) };
+	}
+	std::sort(keyed.begin(), keyed.end());
+	std::vector<uint64_t> cellKeys; // cell of every cluster on the current level
+	for (const auto& [key, vertex] : keyed) {
+		if (cellKeys.empty() || cellKeys.back() != key) {
+			cellKeys.push_back(key);
+		}
+		leafOf[vertex] = static_cast<uint32_t>(cellKeys.size() - 1);
+	}
+	levels.back().clusters.resize(cellKeys.size());
+
+	// coarser levels merge 2x2 cells
+	for (size_t level = levelCount - 1; level > 0; --level) {
+		std::vector<uint64_t> parentKeys;
+		auto& parents = levels[level].parents;
+		parents.resize(cellKeys.size());
+		std::vector<std::pair<uint64_t, uint32_t>> halved(cellKeys.size());
+		for (size_t i = 0; i < cellKeys.size(); ++i) {
+			halved[i] = { (cellKeys[i] >> 33) << 32 | (cellKeys[i] & 0xFFFFFFFFu) >> 1, static_cast<uint32_t>(i) };
+		}
+		std::sort(halved.begin(), halved.end());
+		for (const auto& [key, cluster] : halved) {
+			if (parentKeys.empty() || parentKeys.back() != key) {
+				parentKeys.push_back(key);
+			}
+			parents[cluster] = static_cast<uint32_t>(parentKeys.size() - 1);
+		}
+		levels[level - 1].clusters.resize(parentKeys.size());
+		cellKeys = std::move(parentKeys);
+	}
+
+	// links are summed on the finest level and then merged upwards, so every edge is looked at once
+	std::vector<std::pair<uint64_t, size_t>> keyedLinks;
+	for (const auto& [from, to] : edges) {
+		if (leafOf[from] != leafOf[to]) {
+			keyedLinks.push_back({ PairKey(leafOf[from], leafOf[to]), 1 });
+		}
+	}
+	levels.back().links = MergeLinks(keyedLinks);
+	for (size_t level = levelCount - 1; level > 0; --level) {
+		keyedLinks.clear();
+		const auto& parents = levels[level].parents;
+		for (const auto& link : levels[level].links) {
+			if (parents[link.from] != parents[link.to]) {
+				keyedLinks.push_back({ PairKey(parents[link.from], parents[link.to]), link.count });
+			}
+		}
+		levels[level - 1].links = MergeLinks(keyedLinks);
+	}
+	UpdateCenters(positions);
+}
+
+void ClusterHierarchy::UpdateCenters(const std::vector<RenderTarget::Point>& positions) {
+	if (levels.empty()) {
+		return;
+	}
+	for (auto& level : levels) {
+		for (auto& cluster : level.clusters) {
+			cluster = { { 0, 0 }, 0 };
+		}
+	}
+	auto& leaves = levels.back().clusters;
+	for (size_t i = 0; i < positions.size(); ++i) { // sums first, divided once every level is summed
+		Cluster& cluster = leaves[leafOf[i]];
+		cluster.center.x += positions[i].x;
+		cluster.center.y += positions[i].y;
+		++cluster.size;
+	}
+	for (size_t level = levels.size() - 1; level > 0; --level) {
+		const auto& parents = levels[level].parents;
+		auto& coarser = levels[level - 1].clusters;
+		for (size_t i = 0; i < parents.size(); ++i) {
+			const Cluster& cluster = levels[level].clusters[i];
+			Cluster& parent = coarser[parents[i]];
+			parent.center.x += cluster.center.x;
+			parent.center.y += cluster.center.y;
+			parent.size += cluster.size;
+		}
+	}
+	for (auto& level : levels) {
+		for (auto& cluster : level.clusters) {
+			cluster.center.x /= cluster.size;
+			cluster.center.y /= cluster.size;
+		}
+	}
+}
+
+bool ClusterHierarchy::IsEmpty() const {
+	return levels.empty();
+}
+
+size_t ClusterHierarchy::LevelCount() const {
+	return levels.size();
+}
+
+double ClusterHierarchy::CellSize(size_t level) const {
+	return side / (1u << level);
+}
+
+const std::vector<ClusterHierarchy::Cluster>& ClusterHierarchy::Clusters(size_t level) const {
+	return levels[level].clusters;
+}
+
+const std::vector<ClusterHierarchy::Link>& ClusterHierarchy::Links(size_t level) const {
+	return levels[level].links;
+}
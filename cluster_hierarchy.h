@@ -0,0 +1,35 @@
+#pragma once
+#include "render_target.h"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+class ClusterHierarchy { // quadtree clustering of a layout: level k cuts the layout's bounding square into 2^k x 2^k cells, one cluster per non-empty cell
+public:
+	struct Cluster {
+		RenderTarget::Point center; // centroid of the cluster's vertices
+		size_t size;
+	};
+	struct Link { // all edges between two clusters of one level
+		uint32_t from;
+		uint32_t to;
+		size_t count;
+	};
+private:
+	struct Level {
+		std::vector<Cluster> clusters;
+		std::vector<uint32_t> parents; // cluster of the next coarser level, unused on level 0
+		std::vector<Link> links; // sorted by count
+	};
+	std::vector<Level> levels; // coarsest first
+	std::vector<uint32_t> leafOf; // finest-level cluster of every vertex
+	double side = 0; // of the bounding square the cells were cut from
+public:
+	void Build(const std::vector<RenderTarget::Point>& positions, const std::vector<std::pair<size_t, size_t>>& edges, size_t levelCount);
+	void UpdateCenters(const std::vector<RenderTarget::Point>& positions); // moves centroids without changing membership
+	bool IsEmpty() const;
+	size_t LevelCount() const;
+	double CellSize(size_t level) const; // side of a cell, in layout units
+	const std::vector<Cluster>& Clusters(size_t level) const;
+	const std::vector<Link>& Links(size_t level) const;
+};
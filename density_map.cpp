@@ -0,0 +1,84 @@
+#include "density_map.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	constexpr uint32_t kernel[3][3] = { { 1, 2, 1 }, { 2, 4, 2 }, { 1, 2, 1 } };
+
+	uint32_t HeatColor(double t) { // black, red, yellow, white
+		auto channel = [t](double shift) { return static_cast<uint32_t>(std::clamp(3 * t - shift, 0.0, 1.0) * 255 + 0.5); };
+		return 0xFF000000u | (channel(2) << 16) | (channel(1) << 8) | channel(0);
+	}
+}
+
+void DensityMap::Reset(int width, int height, size_t pointCount) {
+	this->width = width;
+	this->height = height;
+	density.assign(static_cast<size_t>(width) * height, 0);
+	splatPixel.assign(pointCount, -1);
+	splatWeight.assign(pointCount, 0);
+}
+
+void DensityMap::Move(size_t point, int x, int y, uint32_t weight) {
+	int pixel = x >= 0 && y >= 0 && x < width && y < height ? y * width + x : -1;
+	if (pixel == splatPixel[point] && weight == splatWeight[point]) {
+		return;
+	}
+	if (splatPixel[point] >= 0) {
+		splat(splatPixel[point], splatWeight[point], false);
+	}
+	if (pixel >= 0) {
+		splat(pixel, weight, true);
+	}
+	splatPixel[point] = pixel;
+	splatWeight[point] = weight;
+}
+
+const std::vector<uint32_t>& DensityMap::ToneMap() {
+	uint32_t maxDensity = 0;
+	for (uint32_t value : density) {
+		maxDensity = std::max(maxDensity, value);
+	}
+	image.resize(density.size());
+	double norm = maxDensity ? 1 / std::log1p(static_cast<double>(maxDensity)) : 0;
+	uint32_t lastValue = 0;
+	uint32_t lastColor = HeatColor(0);
+	for (size_t i = 0; i < density.size(); ++i) {
+		if (density[i] != lastValue) { // neighbouring pixels often share a value, so the logarithm is taken far fewer times than there are pixels
+			lastValue = density[i];
+			lastColor = HeatColor(std::log1p(static_cast<double>(lastValue)) * norm);
+		}
+		image[i] = lastColor;
+	}
+	return image;
+}
+
+int DensityMap::Width() const {
+	return width;
+}
+
+int DensityMap::Height() const {
+	return height;
+}
+
+size_t DensityMap::PointCount() const {
+	return splatPixel.size();
+}
+
+void DensityMap::splat(int pixel, uint32_t weight, bool isAdded) {
+	int x = pixel % width;
+	int y = pixel / width;
+	for (int dy = -1; dy <= 1; ++dy) {
+		if (y + dy < 0 || y + dy >= height) {
+			continue;
+		}
+		for (int dx = -1; dx <= 1; ++dx) {
+			if (x + dx < 0 || x + dx >= width) {
+				continue;
+			}
+			uint32_t& value = density[static_cast<size_t>(y + dy) * width + x + dx];
+			uint32_t amount = kernel[dy + 1][dx + 1] * weight;
+			value = isAdded ? value + amount : value - amount;
+		}
+	}
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+class DensityMap { // per-pixel density of splatted points, updated incrementally as the points move
+private:
+	int width = 0;
+	int height = 0;
+	std::vector<uint32_t> density; // sum of kernel weights per pixel
+	std::vector<int> splatPixel; // pixel each point is splatted at, -1 when off screen
+	std::vector<uint32_t> splatWeight;
+	std::vector<uint32_t> image;
+public:
+	void Reset(int width, int height, size_t pointCount); // forgets every splat
+	void Move(size_t point, int x, int y, uint32_t weight); // re-splats point at pixel (x, y), touching the buffer only if the pixel changed
+	const std::vector<uint32_t>& ToneMap(); // log-scaled density as an RGBA image, red in the lowest byte
+	int Width() const;
+	int Height() const;
+	size_t PointCount() const;
+private:
+	void splat(int pixel, uint32_t weight, bool isAdded);
+};
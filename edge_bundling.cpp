@@ -0,0 +1,203 @@
+#include "edge_bundling.h"
+#include "spatial_grid.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	using Point = RenderTarget::Point;
+	constexpr size_t chunkSize = 64; // edges a thread claims at once
+	constexpr double minLength = 1e-9; // shorter edges are left straight
+
+	double Length(const RenderTarget::Line& edge) {
+		return std::hypot(edge.x1 - edge.x0, edge.y1 - edge.y0);
+	}
+
+	double Visibility(const RenderTarget::Line& p, const RenderTarget::Line& q) { // how much of p faces q once q is projected onto p's line
+		double dx = p.x1 - p.x0;
+		double dy = p.y1 - p.y0;
+		double squared = dx * dx + dy * dy;
+		auto project = [&p, dx, dy, squared](double x, double y) {
+			double t = ((x - p.x0) * dx + (y - p.y0) * dy) / squared;
+			return Point{ p.x0 + t * dx, p.y0 + t * dy };
+		};
+		Point start = project(q.x0, q.y0);
+		Point end = project(q.x1, q.y1);
+		double span = std::hypot(end.x - start.x, end.y - start.y);
+		if (span < minLength) {
+			return 0;
+		}
+		double offset = std::hypot((start.x + end.x - p.x0 - p.x1) / 2, (start.y + end.y - p.y0 - p.y1) / 2);
+		return std::max(0.0, 1 - 2 * offset / span);
+	}
+
+	double Compatibility(const RenderTarget::Line& p, double pLength, const RenderTarget::Line& q, double qLength) {
+		double angle = std::abs(((p.x1 - p.x0) * (q.x1 - q.x0) + (p.y1 - p.y0) * (q.y1 - q.y0)) / (pLength * qLength));
+		double average = (pLength + qLength) / 2;
+		double scale = 2 / (average / std::min(pLength, qLength) + std::max(pLength, qLength) / average);
+		double distance = std::hypot((p.x0 + p.x1 - q.x0 - q.x1) / 2, (p.y0 + p.y1 - q.y0 - q.y1) / 2);
+		double position = average / (average + distance);
+		double product = angle * scale * position;
+		return product == 0 ? 0 : product * std::min(Visibility(p, q), Visibility(q, p));
+	}
+}
+
+EdgeBundler::EdgeBundler() :EdgeBundler(Options{}) {
+}
+
+EdgeBundler::EdgeBundler(const Options& options) :options{ options } {
+}
+
+void EdgeBundler::parallelFor(size_t count, const ThreadPool::RangeBody& body) {
+	ThreadPool::Shared().ParallelFor(count, chunkSize, body, options.threadCount, ThreadPool::Priority::Low);
+}
+
+EdgeBundler::Polylines EdgeBundler::Bundle(const std::vector<RenderTarget::Line>& edges) {
+	segments = 1;
+	points.clear();
+	for (const auto& edge : edges) {
+		points.push_back({ edge.x0, edge.y0 });
+		points.push_back({ edge.x1, edge.y1 });
+	}
+	findNeighbours(edges);
+	size_t iterations = options.iterations;
+	double step = options.step;
+	for (size_t cycle = 0; cycle < options.cycles; ++cycle) {
+		subdivide(edges.size());
+		for (size_t i = 0; i < iterations; ++i) {
+			relax(edges, step);
+		}
+		iterations = iterations * 2 / 3;
+		step /= 2;
+	}
+
+	Polylines result;
+	result.starts.reserve(edges.size() + 1);
+	for (size_t edge = 0; edge <= edges.size(); ++edge) {
+		result.starts.push_back(edge * (segments + 1));
+	}
+	result.points = std::move(points);
+	points.clear();
+	return result;
+}
+
+void EdgeBundler::findNeighbours(const std::vector<RenderTarget::Line>& edges) {
+	// Position compatibility alone falls below the threshold once the middles are further apart than
+	// (1 / threshold - 1) times the average length, and scale compatibility once one edge is more than
+	// 4 / threshold - 1 times longer than the other, so a box around each middle finds every candidate.
+	double threshold = std::clamp(options.minCompatibility, 0.01, 1.0);
+	double reach = (2 / threshold) * (1 / threshold - 1);
+	std::vector<double> lengths(edges.size());
+	std::vector<SpatialGrid::Box> middles(edges.size());
+	for (size_t i = 0; i < edges.size(); ++i) {
+		lengths[i] = Length(edges[i]);
+		double x = (edges[i].x0 + edges[i].x1) / 2;
+		double y = (edges[i].y0 + edges[i].y1) / 2;
+		middles[i] = { x, y, x, y };
+	}
+	SpatialGrid grid;
+	grid.Build(middles);
+
+	std::vector<std::vector<Neighbour>> found(edges.size());
+	parallelFor(edges.size(), [&](size_t begin, size_t end) {
+		std::vector<size_t> candidates;
+		std::vector<char> seen;
+		for (size_t e = begin; e < end; ++e) {
+			if (lengths[e] < minLength) {
+				continue;
+			}
+			double radius = reach * lengths[e];
+			candidates.clear();
+			grid.Query({ middles[e].minX - radius, middles[e].minY - radius, middles[e].maxX + radius, middles[e].maxY + radius }, candidates, seen);
+			for (size_t other : candidates) {
+				if (other == e || lengths[other] < minLength) {
+					continue;
+				}
+				double compatibility = Compatibility(edges[e], lengths[e], edges[other], lengths[other]);
+				if (compatibility >= threshold) {
+					bool isReversed = (edges[e].x1 - edges[e].x0) * (edges[other].x1 - edges[other].x0) + (edges[e].y1 - edges[e].y0) * (edges[other].y1 - edges[other].y0) < 0;
+					found[e].push_back({ static_cast<uint32_t>(other), static_cast<float>(compatibility), isReversed });
+				}
+			}
+		}
+	});
+	neighbourStarts.assign(1, 0);
+	neighbours.clear();
+	for (auto& list : found) {
+		neighbours.insert(neighbours.end(), list.begin(), list.end());
+		neighbourStarts.push_back(neighbours.size());
+	}
+}
+
+void EdgeBundler::subdivide(size_t edgeCount) {
+	size_t stride = segments + 1;
+	size_t nextSegments = segments * 2;
+	nextPoints.resize(edgeCount * (nextSegments + 1));
+	parallelFor(edgeCount, [&](size_t begin, size_t end) {
+		for (size_t e = begin; e < end; ++e) {
+			const Point* polyline = &points[e * stride];
+			Point* result = &nextPoints[e * (nextSegments + 1)];
+			double total = 0;
+			for (size_t i = 0; i < segments; ++i) {
+				total += std::hypot(polyline[i + 1].x - polyline[i].x, polyline[i + 1].y - polyline[i].y);
+			}
+			result[0] = polyline[0];
+			result[nextSegments] = polyline[segments];
+			size_t segment = 0;
+			double walked = 0; // length of the polyline before segment
+			for (size_t i = 1; i < nextSegments; ++i) {
+				double target = total * i / nextSegments;
+				double length = std::hypot(polyline[segment + 1].x - polyline[segment].x, polyline[segment + 1].y - polyline[segment].y);
+				while (segment + 1 < segments && walked + length < target) {
+					walked += length;
+					++segment;
+					length = std::hypot(polyline[segment + 1].x - polyline[segment].x, polyline[segment + 1].y - polyline[segment].y);
+				}
+				double t = length > 0 ? std::clamp((target - walked) / length, 0.0, 1.0) : 0;
+				result[i] = { polyline[segment].x + (polyline[segment + 1].x - polyline[segment].x) * t, polyline[segment].y + (polyline[segment + 1].y - polyline[segment].y) * t };
+			}
+		}
+	});
+	points.swap(nextPoints);
+	segments = nextSegments;
+}
+
+void EdgeBundler::relax(const std::vector<RenderTarget::Line>& edges, double step) {
+	size_t stride = segments + 1;
+	nextPoints.resize(points.size());
+	parallelFor(edges.size(), [&](size_t begin, size_t end) {
+		for (size_t e = begin; e < end; ++e) {
+			const Point* polyline = &points[e * stride];
+			Point* result = &nextPoints[e * stride];
+			result[0] = polyline[0];
+			result[segments] = polyline[segments];
+			double length = Length(edges[e]);
+			double spring = options.stiffness * segments / std::max(length, minLength);
+			double totalWeight = 0;
+			for (size_t n = neighbourStarts[e]; n < neighbourStarts[e + 1]; ++n) {
+				totalWeight += neighbours[n].weight;
+			}
+			double attraction = 1 / std::max(1.0, totalWeight);
+			for (size_t i = 1; i < segments; ++i) {
+				const Point& point = polyline[i];
+				double forceX = spring * (polyline[i - 1].x + polyline[i + 1].x - 2 * point.x);
+				double forceY = spring * (polyline[i - 1].y + polyline[i + 1].y - 2 * point.y);
+				for (size_t n = neighbourStarts[e]; n < neighbourStarts[e + 1]; ++n) { // pulls towards the matching point of every compatible edge
+					const Neighbour& neighbour = neighbours[n];
+					const Point& other = points[neighbour.edge * stride + (neighbour.isReversed ? segments - i : i)];
+					double dx = other.x - point.x;
+					double dy = other.y - point.y;
+					double distance = std::sqrt(dx * dx + dy * dy);
+					if (distance > minLength) {
+						double k = attraction * neighbour.weight / distance;
+						forceX += dx * k;
+						forceY += dy * k;
+					}
+				}
+				double force = std::sqrt(forceX * forceX + forceY * forceY);
+				double k = step * length / std::max(1.0, force);
+				result[i] = { point.x + forceX * k, point.y + forceY * k };
+			}
+		}
+	});
+	points.swap(nextPoints);
+}
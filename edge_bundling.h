@@ -0,0 +1,42 @@
+#pragma once
+#include "render_target.h"
+#include "thread_pool.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+class EdgeBundler { // force-directed edge bundling (Holten, van Wijk): edges become polylines whose control points attract those of compatible edges
+public:
+	struct Options {
+		size_t cycles = 5; // every cycle doubles the control points of each edge
+		size_t iterations = 40; // steps of the first cycle, every later cycle takes two thirds as many
+		double step = 0.02; // largest move of a control point per step, as a share of its edge's length; halved every cycle
+		double stiffness = 0.1; // springs between neighbouring control points, keeping polylines smooth
+		double minCompatibility = 0.6; // product of angle, scale, position and visibility compatibility two edges need to attract
+		size_t threadCount = 0; // most threads of the shared pool to use, 0 for all of them
+	};
+	struct Polylines { // polyline i runs through points[starts[i]] .. points[starts[i + 1] - 1], from the edge's first end to its second
+		std::vector<RenderTarget::Point> points;
+		std::vector<size_t> starts;
+	};
+private:
+	struct Neighbour {
+		uint32_t edge;
+		float weight; // compatibility
+		bool isReversed; // runs the other way, so control point i attracts the neighbour's point from the other end
+	};
+	Options options;
+	std::vector<size_t> neighbourStarts; // neighbours of edge e are neighbours[neighbourStarts[e] .. neighbourStarts[e + 1])
+	std::vector<Neighbour> neighbours;
+	std::vector<RenderTarget::Point> points; // segments + 1 per edge, ends included
+	std::vector<RenderTarget::Point> nextPoints;
+	size_t segments = 1;
+public:
+	EdgeBundler();
+	explicit EdgeBundler(const Options& options);
+	Polylines Bundle(const std::vector<RenderTarget::Line>& edges);
+private:
+	void findNeighbours(const std::vector<RenderTarget::Line>& edges);
+	void subdivide(size_t edgeCount); // doubles segments, spacing control points evenly along each polyline
+	void relax(const std::vector<RenderTarget::Line>& edges, double step); // one step of spring and attraction forces
+	void parallelFor(size_t count, const ThreadPool::RangeBody& body); // on the shared pool, at low priority so frames come first
+};
@@ -0,0 +1,58 @@
+#include "frame_scheduler.h"
+#include <stdexcept>
+#include <thread>
+
+FrameScheduler::FrameScheduler(double framesPerSecond, Mode mode) : mode{ mode } {
+	if (!(framesPerSecond > 0)) {
+		throw std::runtime_error{ "frame rate must be positive" };
+	}
+	period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond));
+}
+
+void FrameScheduler::FramePresented() {
+	isPresented = true;
+}
+
+void FrameScheduler::WaitForNextFrame() {
+	auto now = Clock::now();
+	if (!hasStarted) {
+		hasStarted = true;
+		deadline = now;
+	} else if (now - deadline >= period) {
+		size_t missed = (now - deadline) / period;
+		missedCount += missed;
+		if (reporter) {
+			reporter(missed, now - deadline);
+		}
+		deadline = now; // starts over rather than rushing frames to catch up
+	}
+
+	if (mode == Mode::Vsync && isPresented) {
+		deadline = now; // the present returned at the vertical blank, which is where the next frame starts
+	} else {
+		std::this_thread::sleep_until(deadline); // an absolute deadline, so oversleeping does not add up across frames
+	}
+	deadline += period;
+	isPresented = false;
+	++frameCount;
+}
+
+void FrameScheduler::SetMissReporter(MissReporter reporter) {
+	this->reporter = std::move(reporter);
+}
+
+size_t FrameScheduler::Frames() const {
+	return frameCount;
+}
+
+size_t FrameScheduler::MissedFrames() const {
+	return missedCount;
+}
+
+FrameScheduler::Mode FrameScheduler::GetMode() const {
+	return mode;
+}
+
+FrameScheduler::Clock::duration FrameScheduler::Period() const {
+	return period;
+}
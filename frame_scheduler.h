@@ -0,0 +1,31 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <functional>
+class FrameScheduler { // paces the frame loop to a target rate and counts frames that missed their slot
+public:
+	enum class Mode {
+		Deadline, // sleeps until fixed steady_clock deadlines
+		Vsync // lets a vsynced present do the waiting; deadlines are used only for frames that present nothing
+	};
+	using Clock = std::chrono::steady_clock;
+	using MissReporter = std::function<void(size_t missedFrames, Clock::duration lateness)>;
+private:
+	Mode mode;
+	Clock::duration period;
+	Clock::time_point deadline; // start of the next frame
+	bool hasStarted = false;
+	bool isPresented = false;
+	size_t frameCount = 0;
+	size_t missedCount = 0;
+	MissReporter reporter;
+public:
+	explicit FrameScheduler(double framesPerSecond = 60, Mode mode = Mode::Deadline);
+	void FramePresented(); // call after presenting; in vsync mode the present has already waited for the display
+	void WaitForNextFrame(); // call once at the end of every loop iteration, whether it presented or not
+	void SetMissReporter(MissReporter reporter); // called whenever a frame overruns its slot by a period or more
+	size_t Frames() const;
+	size_t MissedFrames() const;
+	Mode GetMode() const;
+	Clock::duration Period() const;
+};
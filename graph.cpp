@@ -1,40 +1,214 @@
 #include "graph.h"
-#include "json.h"
+#include "alloc_tracking.h"
+#include "json_cursor.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include <algorithm>
 #include <cmath>
-#include <fstream>
+#include <functional>
+#include <map>
 
 constexpr double PI = 3.141592653589793238463;
 constexpr double xMiddle = 400;
 constexpr double yMiddle = 300;
 constexpr double r = std::min(xMiddle - 30, yMiddle - 30);
+constexpr std::chrono::seconds rateWindow{ 1 };
+constexpr size_t clusterLevels = 12;
+constexpr size_t minClusteredVertices = 2000;
+constexpr double minClusterPixels = 24; // the finest level whose cells are at least this big on screen is drawn
+constexpr size_t minClusterGain = 4; // vertices per visible cluster needed for clusters to be drawn
+constexpr std::chrono::seconds clusterRebuildInterval{ 1 }; // while vertices move, membership is kept this long and only centers follow
+constexpr std::chrono::milliseconds indexRebuildInterval{ 250 }; // while vertices move, the grids are rebuilt at most this often
+constexpr double moveK = 0.1; // share of its force a vertex moves by in a layout step
+constexpr double startMaxForceSquare = 500 * 500 / moveK; // forces are clamped to this at first, then a little less every step
+constexpr size_t forceGrain = 256; // vertices per task of a layout phase
+constexpr size_t coulombBlock = 64; // vertices per block of the Coulomb schedule, which waits for its threads once per block
+constexpr size_t batchGrain = 4096; // elements per task when building draw batches
+constexpr size_t minLoadBatch = 4096; // elements parsed before a partial graph is handed on
+constexpr size_t loadGrain = 512; // elements per task when reading the map
 
-Graph::Graph(const std::string& filename) {
-	std::ifstream in(filename);
-	Json::Document document = Json::Load(in);
-	auto nodeMap = document.GetRoot().AsMap();
-	adjacencyList.reserve(nodeMap["points"].AsArray().size());
-	std::map<size_t, size_t> idxConverter;
-	double phi = 0;
-	double phi_step = 2 * PI / nodeMap["points"].AsArray().size();
-	for (const auto& vertexNode : nodeMap["points"].AsArray()) {
-		auto vertexMap = vertexNode.AsMap();
-		idxConverter[vertexMap["idx"].AsInt()] = adjacencyList.size();
-		adjacencyList.push_back( {static_cast<size_t>(vertexMap["idx"].AsInt()), std::nullopt, std::list<Vertex::Edge>(),
-			{xMiddle + r * std::cos(phi), yMiddle + r * std::sin(phi)} });
-		if (!vertexMap["post_idx"].IsNull()) {
-			adjacencyList.back().postIdx = static_cast<size_t>(vertexMap["post_idx"].AsInt());
-		}
-		phi += phi_step;
-	}
-	for (const auto& edgeNode : nodeMap["lines"].AsArray()) {
-		auto edgeMap = edgeNode.AsMap();
-		size_t from = idxConverter[edgeMap["points"].AsArray()[0].AsInt()];
-		Vertex::Edge edge(edgeMap["idx"].AsInt(), idxConverter[edgeMap["points"].AsArray()[1].AsInt()], edgeMap["length"].AsDouble());
+static double MsBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+Graph::Graph() :maxAllowedSquare{ startMaxForceSquare } {
+	Publish();
+}
+
+Graph::Graph(const std::string& filename) :maxAllowedSquare{ startMaxForceSquare } {
+	TRACE_SCOPE("Graph::Graph");
+	Load(filename);
+	AddLoadedEdges();
+	Publish();
+}
+
+void Graph::Load(const std::string& filename) {
+	TRACE_SCOPE("Graph::Load");
+	ALLOC_SCOPE(AllocTracking::Subsystem::Load);
+	forces.clear(); // the layout starts over
+	maxAllowedSquare = startMaxForceSquare;
+	MappedFile file(filename);
+	std::string_view text = file.View();
+	Json::Cursor root(text);
+	auto fractionAt = [&text](Json::Cursor node) { return static_cast<double>(node.Raw().data() - text.data()) / text.size(); };
+	auto placeOnCircle = [this]() {
+		double phi = 0;
+		double phi_step = 2 * PI / adjacencyList.size();
+		for (auto& vertex : adjacencyList) {
+			vertex.point = { xMiddle + r * std::cos(phi), yMiddle + r * std::sin(phi) };
+			phi += phi_step;
+		}
+	};
+	auto report = [this](double fraction) {
+		std::lock_guard<std::mutex> guard(loadLock);
+		loadProgress.vertices = adjacencyList.size();
+		loadProgress.fraction = fraction;
+	};
+
+	std::pmr::monotonic_buffer_resource loadArena; // released in one go once the file is read
+	std::pmr::map<size_t, size_t> idxConverter(&loadArena);
+	ThreadPool& pool = ThreadPool::Shared();
+	// Elements are found in one pass, then read batch by batch on the pool and stitched on in file order, so
+	// partial graphs are published as before.
+	struct ParsedVertex {
+		size_t idx;
+		std::optional<size_t> postIdx;
+	};
+	std::vector<Json::Cursor> vertexNodes = root.At("points").Elements();
+	std::vector<ParsedVertex> vertices;
+	for (size_t begin = 0; begin < vertexNodes.size() && !isLoadCancelled;) {
+		size_t end = std::min(vertexNodes.size(), begin + std::max(minLoadBatch, begin)); // batches double, so the circle is laid out O(log n) times
+		vertices.resize(end - begin);
+		pool.ParallelFor(end - begin, loadGrain, [&](size_t first, size_t last) {
+			for (size_t i = first; i < last && !isLoadCancelled; ++i) {
+				const Json::Cursor& vertexNode = vertexNodes[begin + i];
+				vertices[i].idx = vertexNode.At("idx").AsInt();
+				auto postIdx = vertexNode.Find("post_idx");
+				vertices[i].postIdx = postIdx && !postIdx->IsNull() ? std::optional<size_t>(postIdx->AsInt()) : std::nullopt;
+			}
+		});
+		if (isLoadCancelled) { // the batch may be half read
+			break;
+		}
+		for (const auto& vertex : vertices) {
+			idxConverter[vertex.idx] = adjacencyList.size();
+			adjacencyList.push_back({ vertex.idx, vertex.postIdx, std::pmr::list<Vertex::Edge>(&edgeArena), {} }); // the layout thread only adds edges once every vertex is in
+		}
+		if (end < vertexNodes.size()) {
+			placeOnCircle();
+			Publish();
+			report(fractionAt(vertexNodes[end - 1]));
+		}
+		begin = end;
+	}
+	placeOnCircle();
+	Publish();
+	{
+		std::lock_guard<std::mutex> guard(loadLock);
+		loadProgress.vertices = adjacencyList.size();
+		loadProgress.areVerticesLoaded = true;
+	}
+
+	auto vertexOf = [&idxConverter](size_t idx) { // only read from here on, so the pool's threads may share it
+		auto found = idxConverter.find(idx);
+		return found != idxConverter.end() ? found->second : 0;
+	};
+	struct ParsedEdge {
+		size_t from;
+		size_t to;
+		size_t idx;
+		double length;
+	};
+	std::vector<Json::Cursor> edgeNodes = root.At("lines").Elements();
+	std::vector<ParsedEdge> edges;
+	std::vector<LoadedEdge> batch;
+	size_t queued = 0;
+	auto queue = [this, &batch, &queued](double fraction) {
+		std::lock_guard<std::mutex> guard(loadLock);
+		loadedEdges.insert(loadedEdges.end(), batch.begin(), batch.end());
+		queued += batch.size();
+		loadProgress.edges = queued;
+		loadProgress.fraction = fraction;
+		batch.clear();
+	};
+	for (size_t begin = 0; begin < edgeNodes.size() && !isLoadCancelled;) {
+		size_t end = std::min(edgeNodes.size(), begin + std::max(minLoadBatch, queued)); // every batch makes ApplyForce rebuild the edge list, so they double too
+		edges.resize(end - begin);
+		pool.ParallelFor(end - begin, loadGrain, [&](size_t first, size_t last) {
+			for (size_t i = first; i < last && !isLoadCancelled; ++i) {
+				const Json::Cursor& edgeNode = edgeNodes[begin + i];
+				size_t ends[2] = {};
+				size_t endCount = 0;
+				edgeNode.At("points").ForEach([&ends, &endCount](Json::Cursor point) {
+					if (endCount < 2) {
+						ends[endCount++] = point.AsInt();
+					}
+				});
+				edges[i] = { vertexOf(ends[0]), vertexOf(ends[1]), static_cast<size_t>(edgeNode.At("idx").AsInt()), edgeNode.At("length").AsDouble() };
+			}
+		});
+		if (isLoadCancelled) {
+			break;
+		}
+		for (const auto& edge : edges) {
+			batch.push_back({ edge.from, Vertex::Edge(edge.idx, edge.to, edge.length) });
+		}
+		begin = end;
+		if (begin < edgeNodes.size()) {
+			queue(fractionAt(edgeNodes[begin - 1]));
+		}
+	}
+	queue(1);
+	std::lock_guard<std::mutex> guard(loadLock);
+	loadProgress.isParsed = true;
+}
+
+void Graph::CancelLoad() {
+	isLoadCancelled = true;
+}
+
+Graph::LoadProgress Graph::GetLoadProgress() {
+	std::lock_guard<std::mutex> guard(loadLock);
+	return loadProgress;
+}
+
+bool Graph::IsLoading() {
+	std::lock_guard<std::mutex> guard(loadLock);
+	return !loadProgress.isParsed || !loadedEdges.empty();
+}
+
+bool Graph::AddLoadedEdges() {
+	std::vector<LoadedEdge> edges;
+	{
+		std::lock_guard<std::mutex> guard(loadLock);
+		edges.swap(loadedEdges);
+	}
+	if (edges.empty()) {
+		return false;
+	}
+	TRACE_SCOPE("Graph::AddLoadedEdges");
+	ALLOC_SCOPE(AllocTracking::Subsystem::Load);
+	for (auto [from, edge] : edges) {
 		AddEdge(from, edge);
 		std::swap(from, edge.to);
 		AddEdge(from, edge);
 		maxLength = std::max(maxLength, edge.length);
 	}
+	auto list = std::make_shared<std::vector<DrawEdge>>();
+	for (size_t i = 0; i < adjacencyList.size(); ++i) {
+		for (const auto& j : adjacencyList[i].edges) {
+			if (j.to < i) {
+				break;
+			}
+			unsigned char color = 255 * (maxLength - j.length + 1) / maxLength;
+			list->push_back({ static_cast<size_t>(i), j.to, { color, color, color } });
+		}
+	}
+	std::stable_sort(list->begin(), list->end(), [](const DrawEdge& lhs, const DrawEdge& rhs) { return lhs.color.r < rhs.color.r; });
+	edgeList = std::move(list);
+	return true;
 }
 
 void Graph::AddEdge(size_t from, Vertex::Edge edge) {
@@ -46,88 +220,376 @@ void Graph::AddEdge(size_t from, Vertex::Edge edge) {
 	}
 }
 
-void Graph::Draw(SdlWindow& window) {
+void Graph::Draw(RenderTarget& target) {
+	TRACE_SCOPE("Graph::Draw");
+	ALLOC_SCOPE(AllocTracking::Subsystem::Draw);
+	auto lockStart = std::chrono::steady_clock::now();
 	writeLock.lock();
-	for (int i = 0; i < adjacencyList.size(); ++i) {
-		for (const auto& j : adjacencyList[i].edges) {
-			if (j.to < i) {
-				break;
+	auto locked = std::chrono::steady_clock::now();
+	TRACE_SPAN("Graph::Draw lock wait", lockStart, locked);
+	stats.drawLockWaitMs = MsBetween(lockStart, locked);
+	std::shared_ptr<const Snapshot> previous = previousSnapshot;
+	std::shared_ptr<const Snapshot> latest = latestSnapshot;
+	std::shared_ptr<const Bundle> bundle = latestBundle;
+	writeLock.unlock();
+
+	// shows the previous snapshot when the latest one arrives and reaches the latest one an interval later,
+	// so vertices move at the layout's pace however often frames are drawn
+	double progress = 1;
+	if (isInterpolated && latest->time > previous->time) {
+		std::chrono::duration<double> interval = latest->time - previous->time;
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - latest->time;
+		progress = std::clamp(elapsed / interval, 0.0, 1.0);
+	}
+	isInterpolating = progress < 1;
+	if (latest->version != indexedVersion || progress != indexedProgress) {
+		size_t drawnCount = drawPositions.size();
+		double step = 0; // furthest any vertex moves along an axis in this frame
+		drawPositions.resize(latest->positions.size());
+		drawBounds = { INFINITY, INFINITY, -INFINITY, -INFINITY };
+		for (size_t i = 0; i < drawPositions.size(); ++i) {
+			const auto& to = latest->positions[i];
+			const auto& from = i < previous->positions.size() ? previous->positions[i] : to; // vertices still being loaded appear in place
+			Vertex::Point point{ from.x + (to.x - from.x) * progress, from.y + (to.y - from.y) * progress };
+			if (i < drawnCount) {
+				step = std::max({ step, std::abs(point.x - drawPositions[i].x), std::abs(point.y - drawPositions[i].y) });
 			}
-			unsigned char color = 255 * (maxLength - j.length + 1) / maxLength;
-			window.SetDrawColor(color, color, color);
-			window.DrawLine(std::round(adjacencyList[i].point.x), std::round(adjacencyList[i].point.y), std::round(adjacencyList[j.to].point.x), std::round(adjacencyList[j.to].point.y));
+			drawPositions[i] = point;
+			drawBounds = { std::min(drawBounds.minX, point.x - 5), std::min(drawBounds.minY, point.y - 5), std::max(drawBounds.maxX, point.x + 5), std::max(drawBounds.maxY, point.y + 5) };
 		}
+		indexedVersion = latest->version;
+		indexedProgress = progress;
+		indexDrift += step;
+		isIndexStale = isIndexStale || drawPositions.size() != drawnCount; // new vertices are missing from the grids
+		areClustersStale = true;
 	}
-	window.SetDrawColor(255, 255, 255);
-	for (const auto& i : adjacencyList) {
-		window.DrawRectangle(std::round(i.point.x - 5), std::round(i.point.y - 5), std::round(i.point.x + 5), std::round(i.point.y + 5));
+	if (latest->edges != drawEdges) {
+		drawEdges = latest->edges;
+		clusters = {}; // links are counted per edge, so the hierarchy is built anew
+		isIndexStale = true;
 	}
-	writeLock.unlock();
+	if (drawPositions.empty()) {
+		return;
+	}
+	if (bundle && (bundle->version != latest->version || progress < 1)) { // vertices have left the places the edges were bundled for
+		bundle.reset();
+	}
+	if (bundle != indexedBundle) {
+		indexedBundle = bundle;
+		isIndexStale = true;
+	}
+	if (renderMode == RenderMode::Density) {
+		DrawDensity(target);
+		return;
+	}
+	if (isIndexStale || (indexDrift > 0 && std::chrono::steady_clock::now() - indexBuilt >= indexRebuildInterval)) {
+		RebuildIndex();
+	}
+
+	const auto& bounds = drawBounds;
+	target.FitTo({ bounds.minX, bounds.minY, bounds.maxX, bounds.maxY });
+	RenderTarget::Area visible = target.VisibleArea();
+	if (isLevelOfDetail && drawPositions.size() >= minClusteredVertices && DrawClusters(target, visible)) {
+		return;
+	}
+	SpatialGrid::Box area{ visible.minX - indexDrift, visible.minY - indexDrift, visible.maxX + indexDrift, visible.maxY + indexDrift }; // finds what moved into view since the grids were built
+	bool isAllVisible = area.minX <= bounds.minX && area.minY <= bounds.minY && area.maxX >= bounds.maxX && area.maxY >= bounds.maxY;
+
+	ThreadPool& pool = ThreadPool::Shared();
+	auto straightLine = [this](const DrawEdge& edge) {
+		const auto& from = drawPositions[edge.from];
+		const auto& to = drawPositions[edge.to];
+		return RenderTarget::Line{ from.x, from.y, to.x, to.y, edge.color };
+	};
+	lineBatch.clear();
+	auto addLine = [this, &straightLine](size_t edge) {
+		const auto& drawEdge = (*drawEdges)[edge];
+		if (!indexedBundle) {
+			lineBatch.push_back(straightLine(drawEdge));
+			return;
+		}
+		const auto& polylines = indexedBundle->polylines;
+		for (size_t i = polylines.starts[edge]; i + 1 < polylines.starts[edge + 1]; ++i) {
+			const auto& from = polylines.points[i];
+			const auto& to = polylines.points[i + 1];
+			lineBatch.push_back({ from.x, from.y, to.x, to.y, drawEdge.color });
+		}
+	};
+	visibleBuffer.clear();
+	if (isAllVisible && !indexedBundle) { // one line per edge, so every task knows where its lines go
+		lineBatch.resize(drawEdges->size());
+		pool.ParallelFor(drawEdges->size(), batchGrain, [this, &straightLine](size_t begin, size_t end) {
+			for (size_t edge = begin; edge < end; ++edge) {
+				lineBatch[edge] = straightLine((*drawEdges)[edge]);
+			}
+		}, 0, ThreadPool::Priority::High);
+	} else if (isAllVisible) {
+		for (size_t edge = 0; edge < drawEdges->size(); ++edge) {
+			addLine(edge);
+		}
+	} else {
+		edgeGrid.Query(area, visibleBuffer);
+		for (size_t edge : visibleBuffer) {
+			addLine(edge);
+		}
+	}
+
+	auto vertexRectangle = [](const Vertex::Point& point) {
+		return RenderTarget::Rectangle{ point.x - 5, point.y - 5, point.x + 5, point.y + 5 };
+	};
+	rectangleBatch.clear();
+	visibleBuffer.clear();
+	if (isAllVisible) {
+		rectangleBatch.resize(drawPositions.size());
+		pool.ParallelFor(drawPositions.size(), batchGrain, [this, &vertexRectangle](size_t begin, size_t end) {
+			for (size_t vertex = begin; vertex < end; ++vertex) {
+				rectangleBatch[vertex] = vertexRectangle(drawPositions[vertex]);
+			}
+		}, 0, ThreadPool::Priority::High);
+	} else {
+		vertexGrid.Query(area, visibleBuffer);
+		for (size_t vertex : visibleBuffer) {
+			rectangleBatch.push_back(vertexRectangle(drawPositions[vertex]));
+		}
+	}
+
+	target.DrawLines(lineBatch);
+	target.DrawRectangles(rectangleBatch, { 255, 255, 255 });
 }
 
-double Graph::ApplyForce() {
-	constexpr double coulombsK = 10000.0;
-	constexpr double moveK = 0.1;
-	static double maxAllowedSquare = 500 * 500 / moveK;
-	static std::vector<std::pair<double, double>> forces;
-	if (forces.empty()) {
-		forces.resize(adjacencyList.size());
+void Graph::DrawDensity(RenderTarget& target) {
+	SpatialGrid::Box bounds{ INFINITY, INFINITY, -INFINITY, -INFINITY };
+	for (const auto& point : drawPositions) {
+		bounds.minX = std::min(bounds.minX, point.x - 5);
+		bounds.minY = std::min(bounds.minY, point.y - 5);
+		bounds.maxX = std::max(bounds.maxX, point.x + 5);
+		bounds.maxY = std::max(bounds.maxY, point.y + 5);
+	}
+	target.FitTo({ bounds.minX, bounds.minY, bounds.maxX, bounds.maxY });
+	RenderTarget::Area visible = target.VisibleArea();
+	int width = target.Width();
+	int height = target.Height();
+	size_t pointCount = drawPositions.size() + drawEdges->size();
+	bool isViewMoved = visible.minX != densityArea.minX || visible.minY != densityArea.minY || visible.maxX != densityArea.maxX || visible.maxY != densityArea.maxY;
+	if (isViewMoved || densityMap.Width() != width || densityMap.Height() != height || densityMap.PointCount() != pointCount) {
+		densityMap.Reset(width, height, pointCount);
+		densityArea = visible;
 	}
 
-	maxAllowedSquare = std::pow(std::sqrt(maxAllowedSquare) * 0.999, 2);
+	double scaleX = width / (visible.maxX - visible.minX);
+	double scaleY = height / (visible.maxY - visible.minY);
+	auto splat = [this, &visible, scaleX, scaleY](size_t point, double x, double y, uint32_t weight) {
+		densityMap.Move(point, static_cast<int>(std::floor((x - visible.minX) * scaleX)), static_cast<int>(std::floor((y - visible.minY) * scaleY)), weight);
+	};
+	for (size_t i = 0; i < drawPositions.size(); ++i) {
+		splat(i, drawPositions[i].x, drawPositions[i].y, 2);
+	}
+	for (size_t i = 0; i < drawEdges->size(); ++i) { // an edge counts as half a vertex at its middle
+		const auto& from = drawPositions[(*drawEdges)[i].from];
+		const auto& to = drawPositions[(*drawEdges)[i].to];
+		splat(drawPositions.size() + i, (from.x + to.x) / 2, (from.y + to.y) / 2, 1);
+	}
+	target.DrawImage(densityMap.ToneMap());
+}
 
-	for (int i = 0; i < adjacencyList.size(); ++i) { // Coulomb's law
-		for (int j = adjacencyList.size() - 1; j > i; --j) {
-			double x = adjacencyList[i].point.x - adjacencyList[j].point.x;
-			double y = adjacencyList[i].point.y - adjacencyList[j].point.y;
+bool Graph::DrawClusters(RenderTarget& target, const RenderTarget::Area& visible) {
+	if (areClustersStale) {
+		auto now = std::chrono::steady_clock::now();
+		if (clusters.IsEmpty() || now - clustersBuilt >= clusterRebuildInterval) {
+			std::vector<std::pair<size_t, size_t>> edges;
+			edges.reserve(drawEdges->size());
+			for (const auto& edge : *drawEdges) {
+				edges.emplace_back(edge.from, edge.to);
+			}
+			clusters.Build(drawPositions, edges, clusterLevels);
+			clustersBuilt = now;
+		} else {
+			clusters.UpdateCenters(drawPositions);
+		}
+		areClustersStale = false;
+	}
 
-			double square = x * x + y * y;
-			double k = coulombsK / (square * std::sqrt(square));
-			double xForce = x * k;
-			double yForce = y * k;
+	double scale = target.Width() / (visible.maxX - visible.minX);
+	size_t level = 0;
+	while (level + 1 < clusters.LevelCount() && clusters.CellSize(level + 1) * scale >= minClusterPixels) {
+		++level;
+	}
+	const auto& levelClusters = clusters.Clusters(level);
+	double margin = clusters.CellSize(level);
+	isClusterVisible.assign(levelClusters.size(), 0);
+	rectangleBatch.clear();
+	size_t visibleVertices = 0;
+	for (size_t i = 0; i < levelClusters.size(); ++i) {
+		const auto& cluster = levelClusters[i];
+		if (cluster.center.x < visible.minX - margin || cluster.center.x > visible.maxX + margin || cluster.center.y < visible.minY - margin || cluster.center.y > visible.maxY + margin) {
+			continue;
+		}
+		isClusterVisible[i] = 1;
+		visibleVertices += cluster.size;
+		double half = std::min(margin * 0.4, 5 * std::sqrt(static_cast<double>(cluster.size)));
+		rectangleBatch.push_back({ cluster.center.x - half, cluster.center.y - half, cluster.center.x + half, cluster.center.y + half });
+	}
+	if (rectangleBatch.size() * minClusterGain > visibleVertices) {
+		return false;
+	}
 
-			forces[i].first += xForce;
-			forces[i].second += yForce;
-			forces[j].first -= xForce;
-			forces[j].second -= yForce;
+	lineBatch.clear();
+	const auto& links = clusters.Links(level);
+	double logMaxCount = links.empty() ? 1 : std::log(static_cast<double>(links.back().count) + 1);
+	for (const auto& link : links) { // sorted by count, so colors only grow and batches need few color changes
+		if (!isClusterVisible[link.from] && !isClusterVisible[link.to]) {
+			continue;
 		}
+		const auto& from = levelClusters[link.from].center;
+		const auto& to = levelClusters[link.to].center;
+		unsigned char color = static_cast<unsigned char>(64 + 191 * std::log(static_cast<double>(link.count) + 1) / logMaxCount);
+		lineBatch.push_back({ from.x, from.y, to.x, to.y, { color, color, color } });
 	}
+	target.DrawLines(lineBatch);
+	target.DrawRectangles(rectangleBatch, { 255, 255, 255 });
+	return true;
+}
 
-	for (int i = 0; i < adjacencyList.size(); ++i) { // push to the middle
-		double x = adjacencyList[i].point.x - xMiddle;
-		double y = adjacencyList[i].point.y - yMiddle;
+void Graph::SetLevelOfDetail(bool isEnabled) {
+	isLevelOfDetail = isEnabled;
+}
+
+void Graph::SetRenderMode(RenderMode mode) {
+	renderMode = mode;
+}
 
-		double k = std::max(1.0, adjacencyList.size() / 500.0) / std::sqrt(x * x + y * y);
-		forces[i].first -= x * k;
-		forces[i].second -= y * k;
+void Graph::RebuildIndex() {
+	TRACE_SCOPE("Graph::RebuildIndex");
+	boxBuffer.clear();
+	for (const auto& point : drawPositions) {
+		boxBuffer.push_back({ point.x - 5, point.y - 5, point.x + 5, point.y + 5 });
 	}
+	vertexGrid.Build(boxBuffer);
+	boxBuffer.clear();
+	for (size_t edge = 0; edge < drawEdges->size(); ++edge) {
+		const auto& from = drawPositions[(*drawEdges)[edge].from];
+		const auto& to = drawPositions[(*drawEdges)[edge].to];
+		SpatialGrid::Box box{ std::min(from.x, to.x), std::min(from.y, to.y), std::max(from.x, to.x), std::max(from.y, to.y) };
+		if (indexedBundle) { // bundled edges bulge out of the box of their ends
+			const auto& polylines = indexedBundle->polylines;
+			for (size_t i = polylines.starts[edge]; i < polylines.starts[edge + 1]; ++i) {
+				const auto& point = polylines.points[i];
+				box = { std::min(box.minX, point.x), std::min(box.minY, point.y), std::max(box.maxX, point.x), std::max(box.maxY, point.y) };
+			}
+		}
+		boxBuffer.push_back(box);
+	}
+	edgeGrid.Build(boxBuffer);
+	isIndexStale = false;
+	indexDrift = 0;
+	indexBuilt = std::chrono::steady_clock::now();
+}
 
-	double maxSquare = 0;
-	for (int i = 0; i < adjacencyList.size(); ++i) { // Hooke's law
+void Graph::DrawPerCall(RenderTarget& target) {
+	writeLock.lock();
+	std::shared_ptr<const Snapshot> latest = latestSnapshot;
+	writeLock.unlock();
+	const auto& positions = latest->positions;
+	for (size_t i = 0; i < adjacencyList.size(); ++i) {
 		for (const auto& j : adjacencyList[i].edges) {
 			if (j.to < i) {
 				break;
 			}
+			unsigned char color = 255 * (maxLength - j.length + 1) / maxLength;
+			target.SetDrawColor(color, color, color);
+			target.DrawLine(std::round(positions[i].x), std::round(positions[i].y), std::round(positions[j.to].x), std::round(positions[j.to].y));
+		}
+	}
+	target.SetDrawColor(255, 255, 255);
+	for (const auto& point : positions) {
+		target.DrawRectangle(std::round(point.x - 5), std::round(point.y - 5), std::round(point.x + 5), std::round(point.y + 5));
+	}
+}
 
-			double x = adjacencyList[i].point.x - adjacencyList[j.to].point.x;
-			double y = adjacencyList[i].point.y - adjacencyList[j.to].point.y;
+double Graph::ApplyForce() {
+	ALLOC_SCOPE(AllocTracking::Subsystem::Layout);
+	constexpr double coulombsK = 10000.0;
+	forces.resize(adjacencyList.size());
+	AddLoadedEdges();
 
-			double k = (maxLength + 1 - j.length) / 100.0;
-			double xForce = x * k;
-			double yForce = y * k;
+	maxAllowedSquare = std::pow(std::sqrt(maxAllowedSquare) * 0.999, 2);
+	auto phaseStart = std::chrono::steady_clock::now();
+	Stats step;
 
-			forces[i].first -= xForce;
-			forces[i].second -= yForce;
-			forces[j.to].first += xForce;
-			forces[j.to].second += yForce;
-		}
+	// Coulomb's law takes every pair once, as a serial loop would. The vertices are cut into blocks, and each round
+	// of a round-robin schedule pairs up blocks so that no block is in two tiles, which lets the tiles of a round add
+	// to the forces of both their blocks on different threads. The schedule does not depend on the thread count, so
+	// neither do the sums.
+	ThreadPool& pool = ThreadPool::Shared();
+	auto addCoulomb = [this](size_t i, size_t j) {
+		double x = adjacencyList[i].point.x - adjacencyList[j].point.x;
+		double y = adjacencyList[i].point.y - adjacencyList[j].point.y;
 
-		double currentForceSquare = forces[i].first * forces[i].first + forces[i].second * forces[i].second;
-		if (currentForceSquare > maxSquare) {
-			maxSquare = currentForceSquare;
+		double square = x * x + y * y;
+		double k = coulombsK / (square * std::sqrt(square));
+		forces[i].first += x * k;
+		forces[i].second += y * k;
+		forces[j].first -= x * k;
+		forces[j].second -= y * k;
+	};
+	size_t blockCount = (adjacencyList.size() + coulombBlock - 1) / coulombBlock;
+	auto blockEnd = [this](size_t block) { return std::min(adjacencyList.size(), (block + 1) * coulombBlock); };
+	pool.ParallelFor(blockCount, 1, [&](size_t begin, size_t end) { // pairs within a block
+		for (size_t block = begin; block < end; ++block) {
+			for (size_t i = block * coulombBlock; i < blockEnd(block); ++i) {
+				for (size_t j = i + 1; j < blockEnd(block); ++j) {
+					addCoulomb(i, j);
+				}
+			}
 		}
+	}, layoutThreads);
+	size_t slots = blockCount + blockCount % 2; // an odd block count gets a slot without a block, whose partner sits the round out
+	for (size_t round = 0; round + 1 < slots; ++round) {
+		pool.ParallelFor(slots / 2, 1, [&](size_t begin, size_t end) {
+			for (size_t tile = begin; tile < end; ++tile) {
+				size_t a = tile == 0 ? slots - 1 : (round + tile) % (slots - 1); // the last slot stays, the others rotate
+				size_t b = (round + slots - 1 - tile) % (slots - 1);
+				if (a >= blockCount || b >= blockCount) {
+					continue;
+				}
+				for (size_t i = a * coulombBlock; i < blockEnd(a); ++i) {
+					for (size_t j = b * coulombBlock; j < blockEnd(b); ++j) {
+						addCoulomb(i, j);
+					}
+				}
+			}
+		}, layoutThreads);
 	}
-	
+	step.coulombMs = endPhase(phaseStart, LayoutPhase::Coulomb);
+
+	pool.ParallelFor(adjacencyList.size(), forceGrain, [this](size_t begin, size_t end) { // push to the middle
+		for (size_t i = begin; i < end; ++i) {
+			double x = adjacencyList[i].point.x - xMiddle;
+			double y = adjacencyList[i].point.y - yMiddle;
+
+			double k = std::max(1.0, adjacencyList.size() / 500.0) / std::sqrt(x * x + y * y);
+			forces[i].first -= x * k;
+			forces[i].second -= y * k;
+		}
+	}, layoutThreads);
+	step.centeringMs = endPhase(phaseStart, LayoutPhase::Centering);
+
+	double maxSquare = pool.Reduce(adjacencyList.size(), forceGrain, 0.0, [this](size_t begin, size_t end) { // Hooke's law
+		double maxSquare = 0;
+		for (size_t i = begin; i < end; ++i) {
+			for (const auto& j : adjacencyList[i].edges) {
+				double x = adjacencyList[i].point.x - adjacencyList[j.to].point.x;
+				double y = adjacencyList[i].point.y - adjacencyList[j.to].point.y;
+
+				double k = (maxLength + 1 - j.length) / 100.0;
+				forces[i].first -= x * k;
+				forces[i].second -= y * k;
+			}
+			maxSquare = std::max(maxSquare, forces[i].first * forces[i].first + forces[i].second * forces[i].second);
+		}
+		return maxSquare;
+	}, [](double lhs, double rhs) { return std::max(lhs, rhs); }, layoutThreads);
+
 	if (maxSquare > maxAllowedSquare) {
 		double k = std::sqrt(maxAllowedSquare) / std::sqrt(maxSquare);
 		for (auto& i : forces) {
@@ -136,17 +598,138 @@ double Graph::ApplyForce() {
 		}
 	}
 
-	double total = 0;
-	writeLock.lock();
-	for (int i = 0; i < adjacencyList.size(); ++i) {
-		double distanceX = forces[i].first * moveK;
-		double distanceY = forces[i].second * moveK;
-		adjacencyList[i].point.x += distanceX;
-		adjacencyList[i].point.y += distanceY;
-		total += std::abs(distanceX) + std::abs(distanceY);
+	step.hookeMs = endPhase(phaseStart, LayoutPhase::Hooke);
+
+	double total = pool.Reduce(adjacencyList.size(), forceGrain, 0.0, [this](size_t begin, size_t end) {
+		double total = 0;
+		for (size_t i = begin; i < end; ++i) {
+			double distanceX = forces[i].first * moveK;
+			double distanceY = forces[i].second * moveK;
+			adjacencyList[i].point.x += distanceX;
+			adjacencyList[i].point.y += distanceY;
+			total += std::abs(distanceX) + std::abs(distanceY);
+		}
+		return total;
+	}, std::plus<double>(), layoutThreads);
+	step.publishMs = endPhase(phaseStart, LayoutPhase::Move);
+	Publish(step);
+	return total;
+}
+
+double Graph::endPhase(std::chrono::steady_clock::time_point& start, LayoutPhase phase) {
+	auto now = std::chrono::steady_clock::now();
+#ifdef ENABLE_TRACE
+	static const char* const traceNames[] = { "Graph::ApplyForce coulomb", "Graph::ApplyForce centering", "Graph::ApplyForce hooke", "Graph::ApplyForce move" };
+	TRACE_SPAN(traceNames[static_cast<size_t>(phase)], start, now);
+#endif
+	if (phaseCallback) {
+		phaseCallback(phase);
+	}
+	double ms = MsBetween(start, now);
+	start = std::chrono::steady_clock::now(); // the callback's time is left out of the next phase
+	return ms;
+}
+
+void Graph::Publish(std::optional<Stats> step) {
+	auto start = std::chrono::steady_clock::now();
+	std::shared_ptr<Snapshot> snapshot = spareSnapshot ? std::move(spareSnapshot) : std::make_shared<Snapshot>(); // steady layout steps allocate nothing
+	snapshot->edges = edgeList;
+	snapshot->positions.clear();
+	snapshot->positions.reserve(adjacencyList.size());
+	for (const auto& vertex : adjacencyList) {
+		snapshot->positions.push_back(vertex.point);
+	}
+	auto lockStart = std::chrono::steady_clock::now();
+	snapshot->time = lockStart;
+	std::lock_guard<std::mutex> guard(writeLock);
+	auto now = std::chrono::steady_clock::now();
+	TRACE_SPAN("Graph::Publish lock wait", lockStart, now);
+	snapshot->version = latestSnapshot ? latestSnapshot->version + 1 : 1;
+	std::shared_ptr<const Snapshot> retired = std::move(previousSnapshot);
+	previousSnapshot = latestSnapshot ? latestSnapshot : snapshot;
+	latestSnapshot = std::move(snapshot);
+	if (retired && retired.use_count() == 1) { // Draw copies snapshots only under writeLock, so nobody can take it any more
+		spareSnapshot = std::const_pointer_cast<Snapshot>(std::move(retired));
+	}
+	if (!step) {
+		return;
+	}
+
+	step->publishMs += MsBetween(start, lockStart);
+	step->layoutLockWaitMs = MsBetween(lockStart, now);
+	step->drawLockWaitMs = stats.drawLockWaitMs;
+	step->iterations = stats.iterations + 1;
+	step->iterationsPerSecond = stats.iterationsPerSecond;
+	if (step->iterations == 1) {
+		rateStart = now;
+		rateStartIterations = 1;
+	} else if (now - rateStart >= rateWindow) {
+		step->iterationsPerSecond = (step->iterations - rateStartIterations) / std::chrono::duration<double>(now - rateStart).count();
+		rateStart = now;
+		rateStartIterations = step->iterations;
 	}
+	stats = *step;
+}
+
+void Graph::BundleEdges() {
+	TRACE_SCOPE("Graph::BundleEdges");
+	std::vector<RenderTarget::Line> edges;
+	edges.reserve(edgeList->size());
+	for (const auto& edge : *edgeList) {
+		const auto& from = adjacencyList[edge.from].point;
+		const auto& to = adjacencyList[edge.to].point;
+		edges.push_back({ from.x, from.y, to.x, to.y, edge.color });
+	}
+	auto bundle = std::make_shared<Bundle>();
+	bundle->polylines = EdgeBundler{}.Bundle(edges);
+	writeLock.lock();
+	bundle->version = latestSnapshot->version + 1; // of the snapshot published below, so views that already show these positions redraw
+	latestBundle = std::move(bundle);
 	writeLock.unlock();
-	return total;
+	Publish();
+	std::lock_guard<std::mutex> guard(writeLock);
+	previousSnapshot = latestSnapshot; // the vertices did not move, there is nothing to interpolate
+}
+
+size_t Graph::PositionsVersion() {
+	std::lock_guard<std::mutex> guard(writeLock);
+	return latestSnapshot->version;
+}
+
+void Graph::SetInterpolated(bool isInterpolated) {
+	this->isInterpolated = isInterpolated;
+}
+
+bool Graph::IsInterpolating() const {
+	return isInterpolating;
+}
+
+void Graph::SetPhaseCallback(PhaseCallback callback) {
+	phaseCallback = std::move(callback);
+}
+
+void Graph::SetLayoutThreadCount(size_t count) {
+	layoutThreads = count;
+}
+
+Graph::Stats Graph::GetStats() {
+	std::lock_guard<std::mutex> guard(writeLock);
+	Stats result = stats;
+	auto sinceRateStart = std::chrono::steady_clock::now() - rateStart;
+	if (result.iterations > 0 && sinceRateStart >= 2 * rateWindow) { // the layout has slowed down or stopped, let the rate fall
+		result.iterationsPerSecond = (result.iterations - rateStartIterations) / std::chrono::duration<double>(sinceRateStart).count();
+	}
+	return result;
+}
+
+size_t Graph::VertexCount() {
+	std::lock_guard<std::mutex> guard(writeLock);
+	return latestSnapshot->positions.size();
+}
+
+size_t Graph::EdgeCount() {
+	std::lock_guard<std::mutex> guard(writeLock);
+	return latestSnapshot->edges->size();
 }
 
 Graph::~Graph() {
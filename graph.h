@@ -2,12 +2,51 @@
 
 #include <vector>
 #include <list>
+#include <memory_resource>
 #include <mutex>
 #include <optional>
 #include <atomic>
-#include "SDL_window.h"
+#include <chrono>
+#include <memory>
+#include <functional>
+#include "render_target.h"
+#include "spatial_grid.h"
+#include "density_map.h"
+#include "cluster_hierarchy.h"
+#include "edge_bundling.h"
+
+constexpr double stableThreshold = 20.0; // ApplyForce result below which the layout counts as settled
 
 class Graph { // class for working with graphs
+public:
+    enum class RenderMode {
+        Elements, // every vertex and edge
+        Density // heatmap of where vertices and edges are, for graphs too big to tell elements apart
+    };
+    struct Stats {
+        size_t iterations = 0; // layout steps so far
+        double iterationsPerSecond = 0; // over the last second or so, 0 once the layout has stopped
+        double coulombMs = 0; // phases of the last layout step
+        double centeringMs = 0;
+        double hookeMs = 0;
+        double publishMs = 0; // moving the vertices and publishing the snapshot
+        double layoutLockWaitMs = 0; // time the last step waited for writeLock
+        double drawLockWaitMs = 0; // time the last Draw waited for writeLock
+    };
+    enum class LayoutPhase { // parts of an ApplyForce step, in the order they run
+        Coulomb,
+        Centering,
+        Hooke,
+        Move // moving the vertices; the snapshot is published after it
+    };
+    using PhaseCallback = std::function<void(LayoutPhase phase)>;
+    struct LoadProgress {
+        size_t vertices = 0; // parsed so far
+        size_t edges = 0;
+        double fraction = 0; // of the file's bytes
+        bool areVerticesLoaded = false; // every vertex is in place, so the layout may start
+        bool isParsed = false; // the whole file is parsed, though ApplyForce may not have added the last edges yet
+    };
 private:
     struct Vertex {
         struct Edge {
@@ -16,24 +55,109 @@ private:
             size_t to;
             double length;
         };
-        struct Point {
-            double x;
-            double y;
-        };
+        using Point = RenderTarget::Point;
         size_t originalIdx;
         std::optional<size_t> postIdx;
-        std::list<Edge> edges;
+        std::pmr::list<Edge> edges; // nodes live in edgeArena
         Point point;
     };
+    struct DrawEdge {
+        size_t from;
+        size_t to;
+        RenderTarget::Color color;
+    };
+    struct LoadedEdge { // parsed, waiting for ApplyForce to add it
+        size_t from;
+        Vertex::Edge edge;
+    };
+    using EdgeList = std::vector<DrawEdge>; // every edge once, sorted by color so a frame needs few color changes
+    std::pmr::monotonic_buffer_resource edgeArena; // edges are never removed, so their nodes are only freed with the graph
     std::vector<Vertex> adjacencyList;
+    std::shared_ptr<const EdgeList> edgeList = std::make_shared<const EdgeList>(); // for adjacencyList; replaced, never changed, as edges arrive
+    std::shared_ptr<const EdgeList> drawEdges; // edges of the snapshot drawPositions were made from
+    std::mutex loadLock;
+    std::vector<LoadedEdge> loadedEdges; // guarded by loadLock
+    LoadProgress loadProgress; // guarded by loadLock
+    std::atomic<bool> isLoadCancelled{ false };
+    struct Snapshot { // positions published by one layout step
+        std::vector<Vertex::Point> positions;
+        std::shared_ptr<const EdgeList> edges;
+        std::chrono::steady_clock::time_point time;
+        size_t version;
+    };
+    struct Bundle { // edges bundled for the positions of one snapshot
+        EdgeBundler::Polylines polylines; // indexed like drawEdges
+        size_t version;
+    };
+    std::vector<RenderTarget::Line> lineBatch;
+    std::vector<RenderTarget::Rectangle> rectangleBatch;
+    std::vector<Vertex::Point> drawPositions; // positions the index was built from, between two snapshots when interpolating
+    SpatialGrid vertexGrid;
+    SpatialGrid edgeGrid; // indexed like drawEdges
+    std::vector<SpatialGrid::Box> boxBuffer;
+    std::vector<size_t> visibleBuffer;
+    std::shared_ptr<const Snapshot> previousSnapshot; // guarded by writeLock, which is held only to swap them
+    std::shared_ptr<const Snapshot> latestSnapshot;
+    std::shared_ptr<Snapshot> spareSnapshot; // a retired snapshot nobody else held, reused by the next Publish
+    std::shared_ptr<const Bundle> latestBundle; // guarded by writeLock
+    std::shared_ptr<const Bundle> indexedBundle; // bundle the edge grid was built for, if it matches drawPositions
+    size_t indexedVersion = 0; // snapshot drawPositions were made from
+    bool isIndexStale = true; // grids miss vertices, edges or the bundle of drawPositions
+    SpatialGrid::Box drawBounds{}; // of the vertex boxes at drawPositions, kept up to date while the grids lag
+    double indexDrift = 0; // furthest a vertex may have moved along an axis since the grids were built
+    std::chrono::steady_clock::time_point indexBuilt;
+    double indexedProgress = 1;
+    Stats stats; // layout part guarded by writeLock
+    PhaseCallback phaseCallback;
+    size_t layoutThreads = 0; // most threads of the shared pool ApplyForce uses, 0 for all of them
+    std::vector<std::pair<double, double>> forces; // by vertex, carried over from one layout step to the next
+    double maxAllowedSquare; // of a force, shrinking with every layout step
+    std::chrono::steady_clock::time_point rateStart; // start of the window iterationsPerSecond is counted over
+    size_t rateStartIterations = 0;
+    RenderMode renderMode = RenderMode::Elements;
+    DensityMap densityMap; // indexed by vertex, then by drawEdges
+    RenderTarget::Area densityArea{}; // view the density map was splatted for
+    ClusterHierarchy clusters;
+    bool areClustersStale = true; // cluster centers lag behind drawPositions
+    std::chrono::steady_clock::time_point clustersBuilt;
+    std::vector<char> isClusterVisible;
+    bool isLevelOfDetail = false;
+    bool isInterpolated = false;
+    bool isInterpolating = false;
     double maxLength = 0;
     std::mutex writeLock;
 public:
+    Graph(); // empty graph for Load to fill while it is drawn and laid out
     explicit Graph(const std::string& filename); // creates graph with points in circular layout from file with json data
-    void Draw(SdlWindow& window); // draws current graph
+    // Parses the file on the calling thread. Vertices are published in growing batches, placed on the circle;
+    // edges are queued for ApplyForce, which adds them between layout steps. Start the layout once
+    // GetLoadProgress().areVerticesLoaded, since vertices are not guarded while they are added.
+    void Load(const std::string& filename);
+    void CancelLoad(); // makes Load skip the rest of the file
+    LoadProgress GetLoadProgress();
+    bool IsLoading(); // edges are still being parsed or waiting for ApplyForce
+    void Draw(RenderTarget& target); // draws current graph
+    void DrawPerCall(RenderTarget& target); // draws current graph with one call per element, kept as a benchmark reference
     double ApplyForce(); // applies forces to vertices
+    size_t PositionsVersion(); // changes whenever ApplyForce moves vertices
+    void BundleEdges(); // bundles edges for the current positions, which Draw then curves until the vertices move again; call between layout steps
+    void SetInterpolated(bool isInterpolated); // makes Draw move vertices smoothly from the previous snapshot to the latest one
+    bool IsInterpolating() const; // the last Draw showed vertices still on their way to the latest snapshot
+    void SetRenderMode(RenderMode mode);
+    void SetLevelOfDetail(bool isEnabled); // lets zoomed-out views of big graphs draw clusters of vertices and the edges between them
+    Stats GetStats();
+    void SetPhaseCallback(PhaseCallback callback); // called by ApplyForce as each phase ends, on its thread; set while no step runs
+    void SetLayoutThreadCount(size_t count); // most threads of the shared pool ApplyForce uses, 0 for all of them; set while no step runs
+    size_t VertexCount(); // of the latest snapshot
+    size_t EdgeCount();
     ~Graph();
 private:
     void AddEdge(size_t from, Vertex::Edge edge);
+    bool AddLoadedEdges(); // moves queued edges into adjacencyList and rebuilds edgeList; false if there were none
+    void RebuildIndex(); // rebuilds both grids from drawPositions
+    void DrawDensity(RenderTarget& target);
+    bool DrawClusters(RenderTarget& target, const RenderTarget::Area& visible); // false when clusters would not save anything at this zoom
+    double endPhase(std::chrono::steady_clock::time_point& start, LayoutPhase phase); // milliseconds the phase took; start moves to now
+    void Publish(std::optional<Stats> step = std::nullopt); // makes the current positions the latest snapshot; step carries the timings of a layout step
 };
 
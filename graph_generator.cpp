@@ -0,0 +1,280 @@
+#include "graph_generator.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#ifdef _WIN32
+#include <io.h>
+#endif
+
+namespace {
+	constexpr int maxLength = 10; // edge lengths are whole numbers from 1 up to this, like the test maps'
+	constexpr size_t postShare = 20; // about one vertex in this many is a post
+	constexpr uint64_t geometricDegree = 6; // mean degree the radius of a geometric graph is chosen for
+	constexpr uint64_t coordinateRange = 1 << 20; // geometric points lie on a grid this many units wide
+	constexpr uint64_t piNumerator = 355; // 355 / 113 is within 3e-7 of pi, and keeps the radius integer math
+	constexpr uint64_t piDenominator = 113;
+	constexpr size_t stationsPerJunction = 6; // rail vertices that are stations on a line rather than junctions
+	constexpr size_t railCrossLinks = 3; // one in this many links across a rail network's columns is built
+	constexpr size_t scaleFreeEdges = 2; // edges every vertex of a scale-free graph brings along
+
+	uint64_t IntegerSqrt(uint64_t value) { // rounded down, digit by digit in base 4
+		uint64_t root = 0;
+		for (uint64_t bit = uint64_t{ 1 } << 62; bit != 0; bit >>= 2) {
+			if (value >= root + bit) {
+				value -= root + bit;
+				root = (root >> 1) + bit;
+			} else {
+				root >>= 1;
+			}
+		}
+		return root;
+	}
+
+	const std::pair<const char*, GraphGenerator::Shape> shapeNames[] = {
+		{ "grid", GraphGenerator::Shape::Grid },
+		{ "geometric", GraphGenerator::Shape::Geometric },
+		{ "rail", GraphGenerator::Shape::Rail },
+		{ "scale-free", GraphGenerator::Shape::ScaleFree },
+		{ "tree", GraphGenerator::Shape::Tree }
+	};
+}
+
+GraphGenerator::GraphGenerator(Shape shape, size_t vertexCount, uint64_t seed) :shape{ shape }, vertexCount{ vertexCount }, random{ seed } {
+	if (vertexCount == 0 || vertexCount > maxVertices) {
+		throw std::runtime_error{ "GraphGenerator: vertex count must be between 1 and " + std::to_string(maxVertices) };
+	}
+}
+
+GraphGenerator::Shape GraphGenerator::ParseShape(const std::string& name) {
+	std::string known;
+	for (const auto& [shapeName, shape] : shapeNames) {
+		if (name == shapeName) {
+			return shape;
+		}
+		known += known.empty() ? shapeName : std::string{ ", " } + shapeName;
+	}
+	throw std::runtime_error{ "GraphGenerator: unknown shape '" + name + "', expected one of " + known };
+}
+
+const char* GraphGenerator::Name(Shape shape) {
+	for (const auto& [shapeName, known] : shapeNames) {
+		if (known == shape) {
+			return shapeName;
+		}
+	}
+	return "unknown";
+}
+
+size_t GraphGenerator::Write(const std::string& filename) {
+	std::FILE* file = std::fopen(filename.c_str(), "wb");
+	if (!file) {
+		throw std::runtime_error{ "GraphGenerator: cannot open " + filename };
+	}
+	try {
+#ifdef _WIN32
+		Json::Writer output{ _fileno(file) };
+#else
+		Json::Writer output{ fileno(file) };
+#endif
+		writer = &output;
+		edgeCount = 0;
+		output.BeginObject();
+		output.Key("name").Value(std::string{ Name(shape) } + '-' + std::to_string(vertexCount));
+		output.Key("idx").Value(1);
+		output.Key("points").BeginArray();
+		size_t posts = 0;
+		for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+			output.BeginObject().Key("idx").Value(vertex + 1).Key("post_idx");
+			if (below(postShare) == 0) {
+				output.Value(++posts);
+			} else {
+				output.Value(nullptr);
+			}
+			output.EndObject();
+		}
+		output.EndArray();
+		output.Key("lines").BeginArray();
+		switch (shape) {
+		case Shape::Grid:
+			writeGrid();
+			break;
+		case Shape::Geometric:
+			writeGeometric();
+			break;
+		case Shape::Rail:
+			writeRail();
+			break;
+		case Shape::ScaleFree:
+			writeScaleFree();
+			break;
+		case Shape::Tree:
+			writeTree();
+			break;
+		}
+		output.EndArray();
+		output.EndObject();
+		output.Flush();
+		writer = nullptr;
+	} catch (...) {
+		writer = nullptr;
+		std::fclose(file);
+		throw;
+	}
+	if (std::fclose(file) != 0) {
+		throw std::runtime_error{ "GraphGenerator: cannot write " + filename };
+	}
+	return edgeCount;
+}
+
+size_t GraphGenerator::below(size_t bound) {
+	return static_cast<size_t>(random() % bound); // the bias is below bound / 2^64
+}
+
+int GraphGenerator::randomLength() {
+	return 1 + static_cast<int>(below(maxLength));
+}
+
+void GraphGenerator::writeEdge(size_t from, size_t to, int length) {
+	writer->BeginObject();
+	writer->Key("idx").Value(++edgeCount);
+	writer->Key("length").Value(length);
+	writer->Key("points").BeginArray().Value(from + 1).Value(to + 1).EndArray();
+	writer->EndObject();
+}
+
+void GraphGenerator::writeGrid() {
+	size_t width = IntegerSqrt(vertexCount);
+	width += width * width < vertexCount ? 1 : 0;
+	for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+		if ((vertex + 1) % width != 0 && vertex + 1 < vertexCount) {
+			writeEdge(vertex, vertex + 1, randomLength());
+		}
+		if (vertex + width < vertexCount) {
+			writeEdge(vertex, vertex + width, randomLength());
+		}
+	}
+}
+
+void GraphGenerator::writeGeometric() {
+	// Points are bucketed into square cells at least as wide as the radius, so each one only looks at the 3x3 cells
+	// around it. Coordinates and distances are integers, so no rounding can differ between compilers.
+	uint64_t radiusSquare = geometricDegree * coordinateRange * coordinateRange * piDenominator / (piNumerator * vertexCount);
+	uint64_t radius = std::max<uint64_t>(1, IntegerSqrt(radiusSquare));
+	radius += radius * radius < radiusSquare ? 1 : 0;
+	size_t cellsPerSide = std::max<size_t>(1, coordinateRange / radius);
+	std::vector<uint32_t> xs(vertexCount);
+	std::vector<uint32_t> ys(vertexCount);
+	for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+		xs[vertex] = static_cast<uint32_t>(random() % coordinateRange);
+		ys[vertex] = static_cast<uint32_t>(random() % coordinateRange);
+	}
+	auto cellOf = [cellsPerSide](uint32_t coordinate) { return static_cast<size_t>(coordinate * cellsPerSide / coordinateRange); };
+	std::vector<uint32_t> cellStarts(cellsPerSide * cellsPerSide + 1, 0); // counting sort of the points by cell
+	for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+		++cellStarts[cellOf(ys[vertex]) * cellsPerSide + cellOf(xs[vertex]) + 1];
+	}
+	for (size_t cell = 1; cell < cellStarts.size(); ++cell) {
+		cellStarts[cell] += cellStarts[cell - 1];
+	}
+	std::vector<uint32_t> cellVertices(vertexCount);
+	std::vector<uint32_t> filled(cellStarts.begin(), cellStarts.end() - 1);
+	for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+		cellVertices[filled[cellOf(ys[vertex]) * cellsPerSide + cellOf(xs[vertex])]++] = static_cast<uint32_t>(vertex);
+	}
+
+	for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+		size_t cellX = cellOf(xs[vertex]);
+		size_t cellY = cellOf(ys[vertex]);
+		for (size_t y = cellY > 0 ? cellY - 1 : 0; y <= std::min(cellY + 1, cellsPerSide - 1); ++y) {
+			for (size_t x = cellX > 0 ? cellX - 1 : 0; x <= std::min(cellX + 1, cellsPerSide - 1); ++x) {
+				size_t cell = y * cellsPerSide + x;
+				for (size_t i = cellStarts[cell]; i < cellStarts[cell + 1]; ++i) {
+					size_t other = cellVertices[i];
+					if (other <= vertex) { // every pair once
+						continue;
+					}
+					int64_t dx = static_cast<int64_t>(xs[vertex]) - xs[other];
+					int64_t dy = static_cast<int64_t>(ys[vertex]) - ys[other];
+					uint64_t distanceSquare = static_cast<uint64_t>(dx * dx + dy * dy);
+					if (distanceSquare >= radiusSquare) {
+						continue;
+					}
+					uint64_t length = 1; // the smallest with length / maxLength >= distance / radius
+					while (length * length * radiusSquare < distanceSquare * maxLength * maxLength) {
+						++length;
+					}
+					writeEdge(vertex, other, static_cast<int>(length));
+				}
+			}
+		}
+	}
+}
+
+void GraphGenerator::writeRail() {
+	// Junctions sit on a grid. Every column is a line, and a share of the links between neighbouring columns is built,
+	// always including the bottom row so the network is connected. The other vertices become stations, spread evenly
+	// over the links. Nothing crosses, so the network stays planar.
+	size_t junctionTarget = std::clamp<size_t>(vertexCount / (stationsPerJunction + 1), std::min<size_t>(vertexCount, 2), vertexCount);
+	size_t width = std::max<size_t>(1, IntegerSqrt(junctionTarget));
+	size_t height = junctionTarget / width;
+	size_t junctions = width * height;
+	std::vector<std::pair<uint32_t, uint32_t>> links;
+	for (size_t y = 0; y < height; ++y) {
+		for (size_t x = 0; x < width; ++x) {
+			size_t junction = y * width + x;
+			if (y + 1 < height) {
+				links.push_back({ static_cast<uint32_t>(junction), static_cast<uint32_t>(junction + width) });
+			}
+			if (x + 1 < width && (y == 0 || below(railCrossLinks) == 0)) {
+				links.push_back({ static_cast<uint32_t>(junction), static_cast<uint32_t>(junction + 1) });
+			}
+		}
+	}
+	size_t stations = vertexCount - junctions;
+	size_t nextStation = junctions;
+	for (size_t link = 0; link < links.size(); ++link) {
+		size_t count = stations / links.size() + (link < stations % links.size() ? 1 : 0);
+		size_t previous = links[link].first;
+		for (size_t station = 0; station < count; ++station) {
+			writeEdge(previous, nextStation, randomLength());
+			previous = nextStation++;
+		}
+		writeEdge(previous, links[link].second, randomLength());
+	}
+}
+
+void GraphGenerator::writeScaleFree() {
+	// Barabasi-Albert: every new vertex joins vertices picked with a probability proportional to their degree, which
+	// is picking a uniform end of the edges so far.
+	std::vector<uint32_t> ends;
+	ends.reserve(2 * scaleFreeEdges * vertexCount);
+	auto add = [this, &ends](size_t from, size_t to) {
+		writeEdge(from, to, randomLength());
+		ends.push_back(static_cast<uint32_t>(from));
+		ends.push_back(static_cast<uint32_t>(to));
+	};
+	size_t seedVertices = std::min(vertexCount, scaleFreeEdges + 1); // a small clique to start from
+	for (size_t vertex = 1; vertex < seedVertices; ++vertex) {
+		for (size_t other = 0; other < vertex; ++other) {
+			add(other, vertex);
+		}
+	}
+	uint32_t targets[scaleFreeEdges];
+	for (size_t vertex = seedVertices; vertex < vertexCount; ++vertex) {
+		size_t endCount = ends.size(); // edges of this vertex do not count yet
+		for (size_t edge = 0; edge < scaleFreeEdges; ++edge) {
+			do {
+				targets[edge] = ends[below(endCount)];
+			} while (std::find(targets, targets + edge, targets[edge]) != targets + edge);
+			add(targets[edge], vertex);
+		}
+	}
+}
+
+void GraphGenerator::writeTree() {
+	for (size_t vertex = 1; vertex < vertexCount; ++vertex) {
+		writeEdge(below(vertex), vertex, randomLength());
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "json_writer.h"
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+
+class GraphGenerator { // writes synthetic maps in the schema of JSON_test_files for scaling tests; the same seed always gives the same file
+public:
+	enum class Shape {
+		Grid, // square lattice
+		Geometric, // random points joined to every point within a radius, about 6 neighbours each
+		Rail, // planar network of junctions joined by lines with stations along them
+		ScaleFree, // preferential attachment, 2 edges per new vertex
+		Tree // random recursive tree
+	};
+	static constexpr size_t maxVertices = 100000000; // indices stay well within the int the loader reads them as
+private:
+	Shape shape;
+	size_t vertexCount;
+	std::mt19937_64 random; // specified by the standard, so files match across compilers; distributions are not, so none are used, nor floating point
+	Json::Writer* writer = nullptr;
+	size_t edgeCount = 0;
+public:
+	GraphGenerator(Shape shape, size_t vertexCount, uint64_t seed); // throws std::runtime_error for a vertexCount of 0 or above maxVertices
+	static Shape ParseShape(const std::string& name); // grid, geometric, rail, scale-free or tree; throws std::runtime_error otherwise
+	static const char* Name(Shape shape);
+	size_t Write(const std::string& filename); // streams the map into filename and returns how many edges it has
+private:
+	size_t below(size_t bound); // uniform in [0, bound)
+	int randomLength();
+	void writeEdge(size_t from, size_t to, int length); // vertices numbered from 0
+	void writeGrid();
+	void writeGeometric();
+	void writeRail();
+	void writeScaleFree();
+	void writeTree();
+};
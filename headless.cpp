@@ -0,0 +1,39 @@
+#include "headless.h"
+#include "software_canvas.h"
+#include "graph.h"
+#include <filesystem>
+
+namespace {
+	constexpr int canvasWidth = 800;
+	constexpr int canvasHeight = 600;
+
+	void Render(Graph& graph, SoftwareCanvas& canvas) {
+		canvas.SetDrawColor(0, 0, 0);
+		canvas.Clear();
+		graph.Draw(canvas);
+		canvas.Update();
+	}
+}
+
+void RunHeadless(const std::string& filename, const std::string& output, int frames) {
+	Graph graph{ filename };
+	SoftwareCanvas canvas{ canvasWidth, canvasHeight, true };
+	SoftwareCanvas::ImageFormat format = SoftwareCanvas::FormatOf(output);
+	if (frames <= 0) {
+		while (graph.ApplyForce() >= stableThreshold) {
+		}
+		Render(graph, canvas); // the first frame only fits the view to the drawing
+		Render(graph, canvas);
+		canvas.Save(output, format);
+		return;
+	}
+	Render(graph, canvas);
+	std::filesystem::path prefix{ output };
+	prefix.replace_extension(); // of the file name only, so dots in directory names stay
+	canvas.RecordFrames(prefix.string(), format);
+	bool isStable = false;
+	for (int frame = 0; frame < frames && !isStable; ++frame) {
+		Render(graph, canvas);
+		isStable = graph.ApplyForce() < stableThreshold;
+	}
+}
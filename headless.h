@@ -0,0 +1,6 @@
+#pragma once
+#include <string>
+
+// lays the map out without opening a window and writes the picture to output (.png or .ppm);
+// with frames > 0 writes up to that many images, one layout step apart, numbered after output's name instead
+void RunHeadless(const std::string& filename, const std::string& output, int frames);
@@ -1,4 +1,11 @@
 #include "json.h"
+#include "alloc_tracking.h"
+#include "json_writer.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
 
 using namespace std;
 
@@ -41,7 +48,7 @@ namespace Json {
     }
 
     bool Node::IsString() const {
-        return std::holds_alternative<std::string>(*this);
+        return std::holds_alternative<String>(*this);
     }
 
     bool Node::IsNull() const {
@@ -52,14 +59,250 @@ namespace Json {
         return root;
     }
 
-    Node LoadArray(istream& input) {
-        vector<Node> result;
+    namespace {
+        constexpr size_t minArenaBytes = 1 << 10; // first block of a document's arena; later blocks grow from there
+
+        shared_ptr<Arena> MakeArena(size_t inputBytes) { // the DOM takes about as many bytes as its text, so that is the first block
+            return make_shared<Arena>(max(inputBytes, minArenaBytes));
+        }
+
+        [[noreturn]] void ThrowParsingError(const char* what) {
+            throw runtime_error{string("Json: ") + what};
+        }
+
+        void SkipSpaces(string_view& input) {
+            size_t pos = 0;
+            while (pos < input.size() && isspace(static_cast<unsigned char>(input[pos]))) {
+                ++pos;
+            }
+            input.remove_prefix(pos);
+        }
+
+        char TakeChar(string_view& input) {
+            SkipSpaces(input);
+            if (input.empty()) {
+                ThrowParsingError("unexpected end of input");
+            }
+            char c = input.front();
+            input.remove_prefix(1);
+            return c;
+        }
+
+        bool TakeIf(string_view& input, char expected) {
+            SkipSpaces(input);
+            if (!input.empty() && input.front() == expected) {
+                input.remove_prefix(1);
+                return true;
+            }
+            return false;
+        }
+
+        unsigned ReadHex4(string_view& input) {
+            if (input.size() < 4) {
+                ThrowParsingError("unexpected end of input");
+            }
+            unsigned code = 0;
+            auto [end, error] = from_chars(input.data(), input.data() + 4, code, 16);
+            if (error != errc{} || end != input.data() + 4) {
+                ThrowParsingError("invalid \\u escape");
+            }
+            input.remove_prefix(4);
+            return code;
+        }
+
+        void AppendUtf8(String& output, unsigned code) {
+            if (code < 0x80) {
+                output.push_back(static_cast<char>(code));
+            } else if (code < 0x800) {
+                output.push_back(static_cast<char>(0xC0 | (code >> 6)));
+                output.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            } else if (code < 0x10000) {
+                output.push_back(static_cast<char>(0xE0 | (code >> 12)));
+                output.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                output.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            } else {
+                output.push_back(static_cast<char>(0xF0 | (code >> 18)));
+                output.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+                output.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                output.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+        }
+
+        String ReadString(string_view& input, pmr::memory_resource* resource) { // input starts right after the opening quote
+            size_t special = input.find_first_of("\"\\");
+            if (special != string_view::npos && input[special] == '"') {
+                String result(input.substr(0, special), resource);
+                input.remove_prefix(special + 1);
+                return result;
+            }
+            String result(resource);
+            while (true) {
+                special = input.find_first_of("\"\\");
+                if (special == string_view::npos) {
+                    ThrowParsingError("unterminated string");
+                }
+                result.append(input.data(), special);
+                char c = input[special];
+                input.remove_prefix(special + 1);
+                if (c == '"') {
+                    return result;
+                }
+                if (input.empty()) {
+                    ThrowParsingError("unterminated string");
+                }
+                char escaped = input.front();
+                input.remove_prefix(1);
+                switch (escaped) {
+                case 'b':
+                    result.push_back('\b');
+                    break;
+                case 'f':
+                    result.push_back('\f');
+                    break;
+                case 'n':
+                    result.push_back('\n');
+                    break;
+                case 'r':
+                    result.push_back('\r');
+                    break;
+                case 't':
+                    result.push_back('\t');
+                    break;
+                case 'u': {
+                    unsigned code = ReadHex4(input);
+                    if (code >= 0xD800 && code < 0xDC00 && input.size() >= 2 && input[0] == '\\' && input[1] == 'u') {
+                        input.remove_prefix(2);
+                        unsigned low = ReadHex4(input);
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    AppendUtf8(result, code);
+                    break;
+                }
+                default:
+                    result.push_back(escaped);
+                }
+            }
+        }
+
+        Node LoadLiteral(string_view& input, string_view literal, Node value) {
+            if (input.substr(0, literal.size()) != literal) {
+                ThrowParsingError("unknown literal");
+            }
+            input.remove_prefix(literal.size());
+            return value;
+        }
+    }
+
+    Node LoadArray(string_view& input, pmr::memory_resource* resource) {
+        Array result(resource);
+        if (TakeIf(input, ']')) {
+            return Node(move(result));
+        }
+        do {
+            result.push_back(LoadNode(input, resource));
+        } while (TakeIf(input, ','));
+        if (TakeChar(input) != ']') {
+            ThrowParsingError("expected ',' or ']'");
+        }
+        return Node(move(result));
+    }
+
+    Node LoadDict(string_view& input, pmr::memory_resource* resource) {
+        Dict result(resource);
+        if (TakeIf(input, '}')) {
+            return Node(move(result));
+        }
+        do {
+            if (TakeChar(input) != '"') {
+                ThrowParsingError("expected a key");
+            }
+            String key = ReadString(input, resource);
+            if (TakeChar(input) != ':') {
+                ThrowParsingError("expected ':'");
+            }
+            result.emplace(move(key), LoadNode(input, resource));
+        } while (TakeIf(input, ','));
+        if (TakeChar(input) != '}') {
+            ThrowParsingError("expected ',' or '}'");
+        }
+        return Node(move(result));
+    }
+
+    Node LoadNumber(string_view& input) {
+        size_t length = 0;
+        bool isInteger = true;
+        while (length < input.size()) {
+            char c = input[length];
+            if (c == '.' || c == 'e' || c == 'E') {
+                isInteger = false;
+            } else if (!isdigit(static_cast<unsigned char>(c)) && c != '-' && c != '+') {
+                break;
+            }
+            ++length;
+        }
+        const char* first = input.data();
+        const char* last = first + length;
+        if (isInteger) {
+            int value = 0;
+            auto [end, error] = from_chars(first, last, value);
+            if (error == errc{} && end == last) {
+                input.remove_prefix(length);
+                return Node(value);
+            }
+        }
+        double value = 0;
+        auto [end, error] = from_chars(first, last, value);
+        if (error != errc{} || end != last) {
+            ThrowParsingError("invalid number");
+        }
+        input.remove_prefix(length);
+        return Node(value);
+    }
+
+    Node LoadNode(string_view& input, pmr::memory_resource* resource) {
+        char c = TakeChar(input);
+        switch (c) {
+        case '[':
+            return LoadArray(input, resource);
+        case '{':
+            return LoadDict(input, resource);
+        case '"':
+            return Node(ReadString(input, resource));
+        case 't':
+            return LoadLiteral(input, "rue", Node(true));
+        case 'f':
+            return LoadLiteral(input, "alse", Node(false));
+        case 'n':
+            return LoadLiteral(input, "ull", Node());
+        default:
+            input = string_view(input.data() - 1, input.size() + 1);
+            return LoadNumber(input);
+        }
+    }
+
+    Document Load(string_view input) {
+        return Load(input, MakeArena(input.size()));
+    }
+
+    Document Load(string_view input, shared_ptr<Arena> arena) {
+        TRACE_SCOPE("Json::Load");
+        ALLOC_SCOPE(AllocTracking::Subsystem::Json);
+        Node root = LoadNode(input, arena.get());
+        SkipSpaces(input);
+        if (!input.empty()) {
+            ThrowParsingError("unexpected characters after the document");
+        }
+        return Document{move(root), move(arena)};
+    }
+
+    Node LoadArray(istream& input, pmr::memory_resource* resource) {
+        Array result(resource);
         char c;
         while ((input >> c) && (c != ']')) {
             if (c != ',') {
                 input.putback(c);
             }
-            result.push_back(LoadNode(input));
+            result.push_back(LoadNode(input, resource));
         }
 
         return Node(move(result));
@@ -78,64 +321,59 @@ namespace Json {
         while (isalpha(input.peek())) {
             s.push_back(input.get());
         }
-        return Node(0);
+        return Node();
     }
     Node LoadNumber(istream& input) {
-        bool isNegative = false;
-        if (input.peek() == '-') {
-            isNegative = true;
-            input.get();
-        }
-        int intPart = 0;
-        while (isdigit(input.peek())) {
-            intPart *= 10;
-            intPart += input.get() - '0';
-        }
-        if (input.peek() != '.') {
-            return Node(intPart * (isNegative ? -1 : 1));
+        string text;
+        while (isdigit(input.peek()) || input.peek() == '-' || input.peek() == '+' || input.peek() == '.' || input.peek() == 'e' || input.peek() == 'E') {
+            text.push_back(static_cast<char>(input.get()));
         }
-        input.get();  // '.'
-        double result = intPart;
-        double fracMult = 0.1;
-        while (isdigit(input.peek())) {
-            result += fracMult * (input.get() - '0');
-            fracMult /= 10;
-        }
-        return Node(result * (isNegative ? -1 : 1));
+        string_view view = text;
+        return LoadNumber(view); // parsed like the text parser does, so doubles come back exactly as written
     }
 
-    Node LoadString(istream& input) {
-        string line;
-        getline(input, line, '"');
-        return Node(move(line));
+    Node LoadString(istream& input, pmr::memory_resource* resource) {
+        string text; // up to and including the closing quote, escapes still in
+        char c;
+        while (input.get(c)) {
+            text.push_back(c);
+            if (c == '"') {
+                break;
+            }
+            if (c == '\\' && input.get(c)) {
+                text.push_back(c);
+            }
+        }
+        string_view view = text;
+        return Node(ReadString(view, resource));
     }
 
-    Node LoadDict(istream& input) {
-        Dict result;
+    Node LoadDict(istream& input, pmr::memory_resource* resource) {
+        Dict result(resource);
         char c;
         while ((input >> c) && (c != '}')) {
             if (c == ',') {
                 input >> c;
             }
 
-            string key = LoadString(input).AsString();
+            Node key = LoadString(input, resource);
             input >> c;
-            result.emplace(move(key), LoadNode(input));
+            result.emplace(move(get<String>(key)), LoadNode(input, resource));
         }
 
         return Node(move(result));
     }
 
-    Node LoadNode(istream& input) {
+    Node LoadNode(istream& input, pmr::memory_resource* resource) {
         char c;
         input >> c;
 
         if (c == '[') {
-            return LoadArray(input);
+            return LoadArray(input, resource);
         } else if (c == '{') {
-            return LoadDict(input);
+            return LoadDict(input, resource);
         } else if (c == '"') {
-            return LoadString(input);
+            return LoadString(input, resource);
         } else if (c == 't' || c == 'f') {
             input.putback(c);
             return LoadBool(input);
@@ -149,69 +387,21 @@ namespace Json {
     }
 
     Document Load(istream& input) {
-        return Document{LoadNode(input)};
-    }
-
-    template<>
-    void PrintValue<string>(const string& value, ostream& output) {
-        output << '"';
-        for (const char c : value) {
-            if (c == '"' || c == '\\') {
-                output << '\\';
-            }
-            output << c;
-        }
-        output << '"';
-    }
-
-    template<>
-    void PrintValue<bool>(const bool& value, std::ostream& output) {
-        output << std::boolalpha << value <<std::noboolalpha;
-    }
-
-    template<>
-    void PrintValue<Array>(const Array& nodes, std::ostream& output) {
-        output << '[';
-        bool first = true;
-        for (const Node& node : nodes) {
-            if (!first) {
-                output << ", ";
-            }
-            first = false;
-            PrintNode(node, output);
-        }
-        output << ']';
-    }
-
-    template<>
-    void PrintValue<Dict>(const Dict& dict, std::ostream& output) {
-        output << '{';
-        bool first = true;
-        for (const auto&[key, node]: dict) {
-            if (!first) {
-                output << ", ";
-            }
-            first = false;
-            PrintValue(key, output);
-            output << ": ";
-            PrintNode(node, output);
-        }
-        output << '}';
-    }
-
-    template<>
-    void PrintValue<std::monostate>(const std::monostate&, std::ostream& output) {
-        output << "null";
+        TRACE_SCOPE("Json::Load");
+        ALLOC_SCOPE(AllocTracking::Subsystem::Json);
+        auto arena = make_shared<Arena>();
+        Node root = LoadNode(input, arena.get());
+        return Document{move(root), move(arena)};
     }
 
     void PrintNode(const Json::Node& node, ostream& output) {
-        visit([&output](const auto& value) { PrintValue(value, output); },
-              node.GetBase());
+        string buffer;
+        Writer(buffer).Value(node);
+        output.write(buffer.data(), buffer.size());
     }
 
     void Print(const Document& document, ostream& output) {
         PrintNode(document.GetRoot(), output);
     }
 
-
 }
@@ -2,7 +2,10 @@
 
 #include <iostream>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -11,10 +14,14 @@ namespace Json {
 
     class Node;
 
-    using Array = std::vector<Node>;
-    using Dict = std::map<std::string, Node>;
+    // Containers and strings take their memory from the resource they were made with, which for parsed documents is
+    // an arena the Document owns. Copies use the default resource.
+    using Array = std::pmr::vector<Node>;
+    using Dict = std::pmr::map<std::pmr::string, Node>;
+    using String = std::pmr::string;
+    using Arena = std::pmr::monotonic_buffer_resource;
 
-    class Node : public std::variant<std::monostate, Array, Dict, bool, int, double, std::string> {
+    class Node : public std::variant<std::monostate, Array, Dict, bool, int, double, String> {
     public:
         using variant::variant;
 
@@ -53,44 +60,36 @@ namespace Json {
         bool IsNull() const;
 
         const auto& AsString() const {
-            return std::get<std::string>(*this);
+            return std::get<String>(*this);
         }
     };
 
     class Document {
     private:
+        std::shared_ptr<Arena> arena; // memory of the nodes, released in one go after them and any documents sharing it
         Node root;
     public:
         explicit Document(Node root) : root(move(root)) {}
 
+        Document(Node root, std::shared_ptr<Arena> arena) : arena(move(arena)), root(move(root)) {}
+
         const Node& GetRoot() const;
     };
 
-    Node LoadNode(std::istream& input);
+    Node LoadNode(std::istream& input, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
     Document Load(std::istream& input);
 
-    void PrintNode(const Node& node, std::ostream& output);
-
-    template<typename Value>
-    void PrintValue(const Value& value, std::ostream& output) {
-        output << value;
-    }
+    // Parses one value from the front of input and advances past it; resource must outlive the node.
+    Node LoadNode(std::string_view& input, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
-    template<>
-    void PrintValue<std::string>(const std::string& value, std::ostream& output);
+    Document Load(std::string_view input); // throws std::runtime_error on malformed input; the nodes live in an arena
 
-    template<>
-    void PrintValue<bool>(const bool& value, std::ostream& output);
+    // Same, with the nodes in arena, which documents parsed one after another on a thread may share,
+    // e.g. the lines of a JSON Lines chunk. The arena is released with the last of them.
+    Document Load(std::string_view input, std::shared_ptr<Arena> arena);
 
-    template<>
-    void PrintValue<Array>(const Array& nodes, std::ostream& output);
-
-    template<>
-    void PrintValue<Dict>(const Dict& dict, std::ostream& output);
-
-    template<>
-    void PrintValue<std::monostate>(const std::monostate&, std::ostream& output);
+    void PrintNode(const Node& node, std::ostream& output);
 
     void Print(const Document& document, std::ostream& output);
 
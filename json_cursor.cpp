@@ -0,0 +1,205 @@
+#include "json_cursor.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+namespace Json {
+
+    namespace {
+        [[noreturn]] void ThrowCursorError(const char* what) {
+            throw runtime_error{string("Json::Cursor: ") + what};
+        }
+
+        void SkipSpaces(string_view& input) {
+            size_t pos = 0;
+            while (pos < input.size() && isspace(static_cast<unsigned char>(input[pos]))) {
+                ++pos;
+            }
+            input.remove_prefix(pos);
+        }
+
+        size_t StringEnd(string_view input, size_t pos) { // pos is just past the opening quote; returns the closing quote
+            while (true) {
+                pos = input.find_first_of("\"\\", pos);
+                if (pos == string_view::npos) {
+                    ThrowCursorError("unterminated string");
+                }
+                if (input[pos] == '"') {
+                    return pos;
+                }
+                pos += 2;
+            }
+        }
+
+        size_t ValueLength(string_view input) {
+            if (input.empty()) {
+                ThrowCursorError("unexpected end of input");
+            }
+            char c = input.front();
+            if (c == '"') {
+                return StringEnd(input, 1) + 1;
+            }
+            if (c != '[' && c != '{') {
+                return min(input.find_first_of(",]} \t\r\n"), input.size());
+            }
+            int depth = 0;
+            for (size_t i = 0; i < input.size(); ++i) {
+                c = input[i];
+                if (c == '"') {
+                    i = StringEnd(input, i + 1);
+                } else if (c == '[' || c == '{') {
+                    ++depth;
+                } else if ((c == ']' || c == '}') && --depth == 0) {
+                    return i + 1;
+                }
+            }
+            ThrowCursorError("unterminated container");
+        }
+
+        void Expect(string_view& input, char expected) {
+            SkipSpaces(input);
+            if (input.empty() || input.front() != expected) {
+                ThrowCursorError("malformed container");
+            }
+            input.remove_prefix(1);
+            SkipSpaces(input);
+        }
+    }
+
+    Cursor::Cursor(string_view text) : text(text) {
+        SkipSpaces(this->text);
+    }
+
+    bool Cursor::IsArray() const {
+        return !text.empty() && text.front() == '[';
+    }
+
+    bool Cursor::IsMap() const {
+        return !text.empty() && text.front() == '{';
+    }
+
+    bool Cursor::IsNull() const {
+        return !text.empty() && text.front() == 'n';
+    }
+
+    bool Cursor::IsBool() const {
+        return !text.empty() && (text.front() == 't' || text.front() == 'f');
+    }
+
+    bool Cursor::IsString() const {
+        return !text.empty() && text.front() == '"';
+    }
+
+    bool Cursor::IsNumber() const {
+        return !text.empty() && (text.front() == '-' || isdigit(static_cast<unsigned char>(text.front())));
+    }
+
+    bool Cursor::AsBool() const {
+        return Load().AsBool();
+    }
+
+    int Cursor::AsInt() const {
+        return Load().AsInt();
+    }
+
+    double Cursor::AsDouble() const {
+        return Load().AsDouble();
+    }
+
+    string Cursor::AsString() const {
+        return string(get<String>(Load()));
+    }
+
+    Node Cursor::Load() const {
+        string_view rest = text;
+        return LoadNode(rest);
+    }
+
+    string_view Cursor::Raw() const {
+        return text.substr(0, ValueLength(text));
+    }
+
+    vector<Cursor> Cursor::Elements() const {
+        vector<Cursor> elements;
+        ForEach([&elements](Cursor element) { elements.push_back(element); });
+        return elements;
+    }
+
+    optional<Cursor> Cursor::Find(string_view key) const {
+        string_view rest = Enter('{');
+        while (true) {
+            SkipSpaces(rest);
+            if (rest.empty() || rest.front() == '}') {
+                return nullopt;
+            }
+            if (rest.front() == ',') {
+                rest.remove_prefix(1);
+                SkipSpaces(rest);
+            }
+            if (rest.empty() || rest.front() != '"') {
+                ThrowCursorError("expected a key");
+            }
+            size_t keyEnd = StringEnd(rest, 1);
+            bool isMatch = rest.substr(1, keyEnd - 1) == key;
+            rest.remove_prefix(keyEnd + 1);
+            Expect(rest, ':');
+            if (isMatch) {
+                Cursor value;
+                value.text = rest;
+                return value;
+            }
+            rest.remove_prefix(ValueLength(rest));
+        }
+    }
+
+    Cursor Cursor::At(string_view key) const {
+        optional<Cursor> value = Find(key);
+        if (!value) {
+            throw out_of_range{"Json::Cursor: no key " + string(key)};
+        }
+        return *value;
+    }
+
+    char Cursor::Front() const {
+        if (text.empty()) {
+            ThrowCursorError("unexpected end of input");
+        }
+        return text.front();
+    }
+
+    string_view Cursor::Enter(char bracket) const {
+        if (Front() != bracket) {
+            ThrowCursorError(bracket == '[' ? "not an array" : "not an object");
+        }
+        return text.substr(1);
+    }
+
+    bool Cursor::Next(string_view& rest, char closing, string_view* key, Cursor& value) {
+        SkipSpaces(rest);
+        if (rest.empty()) {
+            ThrowCursorError("unexpected end of input");
+        }
+        if (rest.front() == closing) {
+            return false;
+        }
+        if (rest.front() == ',') {
+            rest.remove_prefix(1);
+            SkipSpaces(rest);
+        }
+        if (key) {
+            if (rest.empty() || rest.front() != '"') {
+                ThrowCursorError("expected a key");
+            }
+            size_t keyEnd = StringEnd(rest, 1);
+            *key = rest.substr(1, keyEnd - 1);
+            rest.remove_prefix(keyEnd + 1);
+            Expect(rest, ':');
+        }
+        value.text = rest;
+        rest.remove_prefix(ValueLength(rest));
+        return true;
+    }
+
+}
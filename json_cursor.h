@@ -0,0 +1,69 @@
+#pragma once
+
+#include "json.h"
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Json {
+
+    // Read-only position of one value inside a JSON text. Nothing is parsed until it is asked for,
+    // and values that are never looked at are skipped over without being built.
+    // The text must outlive every cursor made from it.
+    class Cursor {
+    public:
+        explicit Cursor(std::string_view text);
+
+        bool IsArray() const;
+        bool IsMap() const;
+        bool IsNull() const;
+        bool IsBool() const;
+        bool IsString() const;
+        bool IsNumber() const;
+
+        bool AsBool() const;
+        int AsInt() const;
+        double AsDouble() const;
+        std::string AsString() const;
+
+        Node Load() const; // builds the DOM of this value only
+
+        std::string_view Raw() const; // text of this value, found by skipping over it
+
+        std::optional<Cursor> Find(std::string_view key) const; // keys are compared as written, without unescaping
+        Cursor At(std::string_view key) const; // throws std::out_of_range when there is no such key
+
+        std::vector<Cursor> Elements() const; // every array element in order, found in one pass so they can be read on several threads
+
+        template<typename Callback>
+        void ForEach(Callback callback) const { // callback(Cursor element) for every array element
+            std::string_view rest = Enter('[');
+            Cursor element;
+            while (Next(rest, ']', nullptr, element)) {
+                callback(element);
+            }
+        }
+
+        template<typename Callback>
+        void ForEachItem(Callback callback) const { // callback(std::string_view key, Cursor value) for every object member
+            std::string_view rest = Enter('{');
+            std::string_view key;
+            Cursor value;
+            while (Next(rest, '}', &key, value)) {
+                callback(key, value);
+            }
+        }
+
+    private:
+        Cursor() = default;
+
+        char Front() const;
+        std::string_view Enter(char bracket) const;
+        static bool Next(std::string_view& rest, char closing, std::string_view* key, Cursor& value);
+
+        std::string_view text; // starts at the value and runs to the end of the document
+    };
+
+}
@@ -0,0 +1,129 @@
+#include "json_lines.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+using namespace std;
+
+namespace Json {
+
+    namespace {
+        struct ParsedLine {
+            size_t offset;
+            Document document;
+        };
+
+        vector<string_view> SplitChunks(string_view text, size_t chunkSize) {
+            vector<string_view> chunks;
+            size_t begin = 0;
+            while (begin < text.size()) {
+                size_t end = begin + max<size_t>(chunkSize, 1);
+                if (end >= text.size()) {
+                    end = text.size();
+                } else {
+                    size_t lineEnd = text.find('\n', end - 1);
+                    end = lineEnd == string_view::npos ? text.size() : lineEnd + 1;
+                }
+                chunks.push_back(text.substr(begin, end - begin));
+                begin = end;
+            }
+            return chunks;
+        }
+
+        void ParseChunk(string_view chunk, size_t chunkOffset, vector<ParsedLine>& lines) {
+            // One arena for the whole chunk, sized like its text, instead of a block per line. A document that is
+            // kept holds on to the arena of its chunk until it is dropped.
+            auto arena = make_shared<Arena>(chunk.size());
+            size_t pos = 0;
+            while (pos < chunk.size()) {
+                size_t lineEnd = min(chunk.find('\n', pos), chunk.size());
+                string_view line = chunk.substr(pos, lineEnd - pos);
+                if (line.find_first_not_of(" \t\r") != string_view::npos) {
+                    lines.push_back({chunkOffset + pos, Load(line, arena)});
+                }
+                pos = lineEnd + 1;
+            }
+        }
+    }
+
+    size_t LoadLines(string_view text, const LineConsumer& consumer, const LinesOptions& options) {
+        vector<string_view> chunks = SplitChunks(text, options.chunkSize);
+
+        atomic<bool> failed{false};
+        exception_ptr error;
+        mutex deliveryLock;
+        vector<optional<vector<ParsedLine>>> ready(options.ordered ? chunks.size() : 0);
+        vector<vector<ParsedLine>> spare; // delivered buffers, emptied, for the next chunk parsed in order
+        size_t nextToDeliver = 0;
+        bool isDelivering = false;
+        size_t count = 0;
+
+        auto deliver = [&consumer, &count](vector<ParsedLine>& lines) {
+            for (ParsedLine& line : lines) {
+                consumer(line.offset, move(line.document));
+            }
+            count += lines.size();
+        };
+
+        auto parseChunks = [&](size_t begin, size_t end) {
+            vector<ParsedLine> lines; // result buffer, reused between chunks
+            try {
+                for (size_t chunk = begin; !failed && chunk < end; ++chunk) {
+                    lines.clear();
+                    ParseChunk(chunks[chunk], chunks[chunk].data() - text.data(), lines);
+                    unique_lock guard(deliveryLock);
+                    if (!options.ordered) {
+                        deliver(lines);
+                        continue;
+                    }
+                    ready[chunk] = move(lines);
+                    if (spare.empty()) {
+                        lines = vector<ParsedLine>();
+                    } else {
+                        lines = move(spare.back());
+                        spare.pop_back();
+                    }
+                    if (isDelivering) {
+                        continue; // whoever is delivering picks this chunk up when its turn comes
+                    }
+                    isDelivering = true;
+                    while (nextToDeliver < ready.size() && ready[nextToDeliver]) {
+                        vector<ParsedLine> batch = move(*ready[nextToDeliver]);
+                        ready[nextToDeliver++].reset();
+                        guard.unlock();
+                        deliver(batch);
+                        batch.clear();
+                        guard.lock();
+                        spare.push_back(move(batch));
+                    }
+                    isDelivering = false;
+                }
+            } catch (...) {
+                lock_guard guard(deliveryLock);
+                if (!error) {
+                    error = current_exception();
+                }
+                failed = true;
+            }
+        };
+
+        ThreadPool::Shared().ParallelFor(chunks.size(), 1, parseChunks, options.threadCount);
+        if (error) {
+            rethrow_exception(error);
+        }
+        return count;
+    }
+
+    size_t LoadLinesFile(const string& filename, const LineConsumer& consumer, const LinesOptions& options) {
+        MappedFile file(filename);
+        return LoadLines(file.View(), consumer, options);
+    }
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "json.h"
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace Json {
+
+    struct LinesOptions {
+        size_t threadCount = 0; // most threads of the shared ThreadPool to use, 0 for all of them
+        size_t chunkSize = 1 << 20; // bytes per task, rounded up to the next line break
+        bool ordered = true; // deliver documents in file order
+    };
+
+    // Called from one thread at a time with the byte offset of the line and its document.
+    using LineConsumer = std::function<void(size_t offset, Document document)>;
+
+    // Parses every non-empty line of a JSON Lines text on the shared ThreadPool and returns the number of documents.
+    size_t LoadLines(std::string_view text, const LineConsumer& consumer, const LinesOptions& options = {});
+
+    // Same as above over a memory-mapped file.
+    size_t LoadLinesFile(const std::string& filename, const LineConsumer& consumer, const LinesOptions& options = {});
+
+}
@@ -0,0 +1,265 @@
+#include "json_push_parser.h"
+
+#include <stdexcept>
+
+using namespace std;
+
+namespace Json {
+
+    namespace {
+        bool IsSpace(char c) {
+            return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+        }
+
+        bool IsNumberChar(char c) {
+            return isdigit(static_cast<unsigned char>(c)) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+        }
+    }
+
+    size_t PushParser::Feed(string_view chunk) {
+        CheckNotFailed();
+        size_t pos = 0;
+        while (pos < chunk.size() && state != State::Done) {
+            char c = chunk[pos];
+            switch (state) {
+            case State::String:
+                pos = FeedString(chunk, pos);
+                continue;
+            case State::Number:
+                if (IsNumberChar(c)) {
+                    token.push_back(c);
+                    ++pos;
+                } else {
+                    CompleteToken(); // c belongs to whatever follows the number
+                }
+                continue;
+            case State::Literal:
+                token.push_back(c);
+                ++pos;
+                if (literal.substr(0, token.size()) != token) {
+                    Fail("unknown literal");
+                }
+                if (token.size() == literal.size()) {
+                    CompleteToken();
+                }
+                continue;
+            default:
+                break;
+            }
+
+            ++pos;
+            if (IsSpace(c)) {
+                continue;
+            }
+            switch (state) {
+            case State::Value:
+                StartValue(c);
+                break;
+            case State::ArrayStart:
+                if (c == ']') {
+                    Close(c);
+                } else {
+                    StartValue(c);
+                }
+                break;
+            case State::ObjectStart:
+                if (c == '}') {
+                    Close(c);
+                    break;
+                }
+                [[fallthrough]];
+            case State::Key:
+                if (c != '"') {
+                    Fail("expected a key");
+                }
+                isKey = true;
+                state = State::String;
+                break;
+            case State::Colon:
+                if (c != ':') {
+                    Fail("expected ':'");
+                }
+                state = State::Value;
+                break;
+            case State::AfterValue:
+                if (c == ',') {
+                    state = frames.back().container.IsArray() ? State::Value : State::Key;
+                } else if (c == ']' || c == '}') {
+                    Close(c);
+                } else {
+                    Fail("expected ',' or a closing bracket");
+                }
+                break;
+            default:
+                break;
+            }
+        }
+        return pos;
+    }
+
+    void PushParser::Finish() {
+        CheckNotFailed();
+        if (state == State::Number) {
+            CompleteToken();
+        } else if (state != State::Done && (state != State::Value || !frames.empty())) {
+            Fail("unexpected end of input");
+        }
+    }
+
+    bool PushParser::IsDone() const {
+        return state == State::Done;
+    }
+
+    Document PushParser::TakeDocument() {
+        if (state != State::Done) {
+            throw logic_error{"Json::PushParser: document is not finished"};
+        }
+        Document document{move(*root)};
+        root.reset();
+        state = State::Value;
+        return document;
+    }
+
+    void PushParser::Reset() {
+        state = State::Value;
+        frames.clear();
+        root.reset();
+        token.clear();
+        literal = {};
+        isKey = false;
+        hasEscape = false;
+        isEscapePending = false;
+    }
+
+    void PushParser::Fail(const char* what) {
+        state = State::Failed;
+        throw runtime_error{string("Json::PushParser: ") + what};
+    }
+
+    void PushParser::CheckNotFailed() const {
+        if (state == State::Failed) {
+            throw logic_error{"Json::PushParser: Reset is needed after an error"};
+        }
+    }
+
+    size_t PushParser::FeedString(string_view chunk, size_t pos) {
+        while (pos < chunk.size()) {
+            if (isEscapePending) {
+                token.push_back(chunk[pos++]);
+                isEscapePending = false;
+                continue;
+            }
+            size_t special = chunk.find_first_of("\"\\", pos);
+            if (special == string_view::npos) {
+                token.append(chunk.data() + pos, chunk.size() - pos);
+                return chunk.size();
+            }
+            token.append(chunk.data() + pos, special - pos);
+            pos = special + 1;
+            if (chunk[special] == '"') {
+                CompleteToken();
+                return pos;
+            }
+            token.push_back('\\');
+            hasEscape = true;
+            isEscapePending = true;
+        }
+        return pos;
+    }
+
+    void PushParser::StartValue(char c) {
+        switch (c) {
+        case '[':
+            frames.push_back({Node(Array()), {}});
+            state = State::ArrayStart;
+            break;
+        case '{':
+            frames.push_back({Node(Dict()), {}});
+            state = State::ObjectStart;
+            break;
+        case '"':
+            isKey = false;
+            state = State::String;
+            break;
+        case 't':
+        case 'f':
+        case 'n':
+            literal = c == 't' ? "true" : c == 'f' ? "false" : "null";
+            token.push_back(c);
+            state = State::Literal;
+            break;
+        default:
+            if (c != '-' && !isdigit(static_cast<unsigned char>(c))) {
+                Fail("unexpected character");
+            }
+            token.push_back(c);
+            state = State::Number;
+        }
+    }
+
+    void PushParser::CompleteToken() {
+        if (state == State::String) {
+            string value;
+            if (hasEscape) {
+                string quoted = '"' + token + '"';
+                string_view view = quoted;
+                try {
+                    value = string(get<String>(LoadNode(view)));
+                } catch (const runtime_error&) { // e.g. a bad \u escape
+                    state = State::Failed;
+                    throw;
+                }
+            } else {
+                value = move(token);
+            }
+            token.clear();
+            hasEscape = false;
+            if (isKey) {
+                isKey = false;
+                frames.back().key = move(value);
+                state = State::Colon;
+            } else {
+                Emit(Node(String(value)));
+            }
+            return;
+        }
+        string_view view = token;
+        Node value;
+        try {
+            value = LoadNode(view);
+        } catch (const runtime_error&) { // e.g. 1-2 or a lone -
+            state = State::Failed;
+            throw;
+        }
+        if (!view.empty()) {
+            Fail("invalid number");
+        }
+        token.clear();
+        Emit(move(value));
+    }
+
+    void PushParser::Emit(Node value) {
+        if (frames.empty()) {
+            root = move(value);
+            state = State::Done;
+            return;
+        }
+        Frame& frame = frames.back();
+        if (frame.container.IsArray()) {
+            get<Array>(frame.container).push_back(move(value));
+        } else {
+            get<Dict>(frame.container).emplace(move(frame.key), move(value));
+        }
+        state = State::AfterValue;
+    }
+
+    void PushParser::Close(char bracket) {
+        if (frames.back().container.IsArray() != (bracket == ']')) {
+            Fail("mismatched brackets");
+        }
+        Node container = move(frames.back().container);
+        frames.pop_back();
+        Emit(move(container));
+    }
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "json.h"
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Json {
+
+    // Incremental parser for text that arrives in pieces, e.g. from a socket.
+    // Keeps its state between Feed calls, so each byte is looked at once no matter how the text is split:
+    //
+    //     while (!chunk.empty()) {
+    //         chunk.remove_prefix(parser.Feed(chunk));
+    //         if (parser.IsDone()) {
+    //             Handle(parser.TakeDocument());
+    //         }
+    //     }
+    class PushParser {
+    public:
+        // Consumes bytes up to the end of the current document and returns how many were used;
+        // bytes after a finished document are left to the caller. Throws std::runtime_error on malformed input,
+        // after which Feed and Finish throw std::logic_error until Reset is called.
+        size_t Feed(std::string_view chunk);
+
+        void Finish(); // marks the end of the input, completing a top-level number that may still be open
+        bool IsDone() const;
+        Document TakeDocument(); // hands out the finished document and gets ready for the next one
+        void Reset(); // drops a partial document, e.g. after an error, to start over with a new one
+
+    private:
+        enum class State {
+            Value,
+            ArrayStart,
+            ObjectStart,
+            Key,
+            Colon,
+            AfterValue,
+            String,
+            Number,
+            Literal,
+            Done,
+            Failed // Feed or Finish threw
+        };
+
+        struct Frame {
+            Node container;
+            std::string key;
+        };
+
+        size_t FeedString(std::string_view chunk, size_t pos);
+        void StartValue(char c);
+        void CompleteToken();
+        void Emit(Node value);
+        void Close(char bracket);
+        [[noreturn]] void Fail(const char* what);
+        void CheckNotFailed() const;
+
+        State state = State::Value;
+        std::vector<Frame> frames;
+        std::optional<Node> root;
+        std::string token;
+        std::string_view literal;
+        bool isKey = false;
+        bool hasEscape = false;
+        bool isEscapePending = false;
+    };
+
+}
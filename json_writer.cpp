@@ -0,0 +1,258 @@
+#include "json_writer.h"
+#include "json.h"
+
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace Json {
+
+    namespace {
+        constexpr size_t flushThreshold = 1 << 16;
+        constexpr int indentWidth = 2;
+    }
+
+    Writer::Writer(string& output, Style style) : buffer(&output), style(style) {}
+
+    Writer::Writer(int fd, Style style) : buffer(&ownBuffer), fd(fd), style(style) {
+        ownBuffer.reserve(flushThreshold * 2);
+    }
+
+    Writer::~Writer() {
+        try {
+            Flush();
+        } catch (const exception&) {
+        }
+    }
+
+    Writer& Writer::BeginObject() {
+        BeforeValue();
+        buffer->push_back('{');
+        scopes.push_back({true, true});
+        return *this;
+    }
+
+    Writer& Writer::EndObject() {
+        Close(true, '}');
+        return *this;
+    }
+
+    Writer& Writer::BeginArray() {
+        BeforeValue();
+        buffer->push_back('[');
+        scopes.push_back({false, true});
+        return *this;
+    }
+
+    Writer& Writer::EndArray() {
+        Close(false, ']');
+        return *this;
+    }
+
+    Writer& Writer::Key(string_view key) {
+        if (scopes.empty() || !scopes.back().isObject || afterKey) {
+            throw logic_error{"Json::Writer: key outside of an object"};
+        }
+        if (!scopes.back().isEmpty) {
+            buffer->push_back(',');
+        }
+        scopes.back().isEmpty = false;
+        NewLine();
+        WriteString(key);
+        buffer->append(style == Style::Pretty ? ": " : ":");
+        afterKey = true;
+        return *this;
+    }
+
+    Writer& Writer::Value(nullptr_t) {
+        BeforeValue();
+        buffer->append("null");
+        return *this;
+    }
+
+    Writer& Writer::Value(bool value) {
+        BeforeValue();
+        buffer->append(value ? "true" : "false");
+        return *this;
+    }
+
+    Writer& Writer::Value(double value) {
+        BeforeValue();
+        if (!isfinite(value)) {
+            buffer->append("null");
+            return *this;
+        }
+        char chars[32];
+        auto [end, error] = to_chars(begin(chars), std::end(chars), value);
+        buffer->append(chars, end);
+        if (string_view(chars, end - chars).find_first_of(".e") == string_view::npos) {
+            buffer->append(".0"); // keeps the value a double when read back
+        }
+        return *this;
+    }
+
+    Writer& Writer::Value(string_view value) {
+        BeforeValue();
+        WriteString(value);
+        return *this;
+    }
+
+    Writer& Writer::Value(const char* value) {
+        return Value(string_view(value));
+    }
+
+    Writer& Writer::Value(const string& value) {
+        return Value(string_view(value));
+    }
+
+    Writer& Writer::Value(const Node& node) {
+        visit([this](const auto& value) {
+            using Type = decay_t<decltype(value)>;
+            if constexpr (is_same_v<Type, monostate>) {
+                Value(nullptr);
+            } else if constexpr (is_same_v<Type, Array>) {
+                BeginArray();
+                for (const Node& element : value) {
+                    Value(element);
+                }
+                EndArray();
+            } else if constexpr (is_same_v<Type, Dict>) {
+                BeginObject();
+                for (const auto& [key, element] : value) {
+                    Key(key);
+                    Value(element);
+                }
+                EndObject();
+            } else if constexpr (is_same_v<Type, String>) {
+                Value(string_view(value));
+            } else {
+                Value(value);
+            }
+        }, node.GetBase());
+        return *this;
+    }
+
+    void Writer::Flush() {
+        if (fd < 0) {
+            return;
+        }
+        const char* data = buffer->data();
+        size_t left = buffer->size();
+        while (left > 0) {
+#ifdef _WIN32
+            int written = _write(fd, data, static_cast<unsigned>(left));
+#else
+            ssize_t written = write(fd, data, left);
+#endif
+            if (written <= 0) {
+                buffer->clear();
+                throw runtime_error{"Json::Writer: failed to write output"};
+            }
+            data += written;
+            left -= written;
+        }
+        buffer->clear();
+    }
+
+    void Writer::BeforeValue() {
+        if (afterKey) {
+            afterKey = false;
+            return;
+        }
+        if (scopes.empty()) {
+            FlushIfFull();
+            return;
+        }
+        if (scopes.back().isObject) {
+            throw logic_error{"Json::Writer: value without a key inside an object"};
+        }
+        if (!scopes.back().isEmpty) {
+            buffer->push_back(',');
+        }
+        scopes.back().isEmpty = false;
+        NewLine();
+        FlushIfFull();
+    }
+
+    void Writer::Close(bool isObject, char bracket) {
+        if (scopes.empty() || scopes.back().isObject != isObject || afterKey) {
+            throw logic_error{"Json::Writer: unbalanced container"};
+        }
+        bool wasEmpty = scopes.back().isEmpty;
+        scopes.pop_back();
+        if (!wasEmpty) {
+            NewLine();
+        }
+        buffer->push_back(bracket);
+        FlushIfFull();
+    }
+
+    void Writer::NewLine() {
+        if (style == Style::Pretty) {
+            buffer->push_back('\n');
+            buffer->append(scopes.size() * indentWidth, ' ');
+        }
+    }
+
+    void Writer::WriteInteger(long long value) {
+        char chars[24];
+        auto [end, error] = to_chars(begin(chars), std::end(chars), value);
+        buffer->append(chars, end);
+    }
+
+    void Writer::WriteInteger(unsigned long long value) {
+        char chars[24];
+        auto [end, error] = to_chars(begin(chars), std::end(chars), value);
+        buffer->append(chars, end);
+    }
+
+    void Writer::WriteString(string_view value) {
+        static constexpr char hexDigits[] = "0123456789abcdef";
+        buffer->push_back('"');
+        size_t plainStart = 0;
+        for (size_t i = 0; i < value.size(); ++i) {
+            unsigned char c = value[i];
+            if (c >= 0x20 && c != '"' && c != '\\') {
+                continue;
+            }
+            buffer->append(value.data() + plainStart, i - plainStart);
+            plainStart = i + 1;
+            buffer->push_back('\\');
+            switch (c) {
+            case '"':
+            case '\\':
+                buffer->push_back(c);
+                break;
+            case '\n':
+                buffer->push_back('n');
+                break;
+            case '\r':
+                buffer->push_back('r');
+                break;
+            case '\t':
+                buffer->push_back('t');
+                break;
+            default:
+                buffer->append("u00");
+                buffer->push_back(hexDigits[c >> 4]);
+                buffer->push_back(hexDigits[c & 0xF]);
+            }
+        }
+        buffer->append(value.data() + plainStart, value.size() - plainStart);
+        buffer->push_back('"');
+    }
+
+    void Writer::FlushIfFull() {
+        if (fd >= 0 && buffer->size() >= flushThreshold) {
+            Flush();
+        }
+    }
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace Json {
+
+    class Node;
+
+    class Writer { // buffered JSON writer into a string or a file descriptor, usable as a stream or with whole nodes
+    public:
+        enum class Style {
+            Compact,
+            Pretty
+        };
+
+        explicit Writer(std::string& output, Style style = Style::Compact); // appends to output
+        explicit Writer(int fd, Style style = Style::Compact); // buffers and writes to fd, which stays open
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+        ~Writer(); // flushes what is left in the buffer
+
+        Writer& BeginObject();
+        Writer& EndObject();
+        Writer& BeginArray();
+        Writer& EndArray();
+        Writer& Key(std::string_view key);
+
+        Writer& Value(std::nullptr_t);
+        Writer& Value(bool value);
+        Writer& Value(double value);
+        Writer& Value(std::string_view value);
+        Writer& Value(const char* value);
+        Writer& Value(const std::string& value);
+        Writer& Value(const Node& node);
+
+        template<typename Integer, std::enable_if_t<std::is_integral_v<Integer> && !std::is_same_v<Integer, bool>, int> = 0>
+        Writer& Value(Integer value) {
+            BeforeValue();
+            if constexpr (std::is_signed_v<Integer>) {
+                WriteInteger(static_cast<long long>(value));
+            } else {
+                WriteInteger(static_cast<unsigned long long>(value));
+            }
+            return *this;
+        }
+
+        void Flush(); // writes the buffer out to fd; no-op for string output
+
+    private:
+        struct Scope {
+            bool isObject;
+            bool isEmpty;
+        };
+
+        void BeforeValue();
+        void Close(bool isObject, char bracket);
+        void NewLine();
+        void WriteInteger(long long value);
+        void WriteInteger(unsigned long long value);
+        void WriteString(std::string_view value);
+        void FlushIfFull();
+
+        std::string ownBuffer;
+        std::string* buffer;
+        int fd = -1;
+        Style style;
+        std::vector<Scope> scopes;
+        bool afterKey = false;
+    };
+
+}
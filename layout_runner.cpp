@@ -0,0 +1,110 @@
+#include "layout_runner.h"
+#include "trace.h"
+#include <stdexcept>
+
+LayoutRunner::LayoutRunner(Graph& graph) :graph{ graph } {
+}
+
+LayoutRunner::~LayoutRunner() {
+	Cancel();
+	Wait();
+}
+
+void LayoutRunner::SetProgressCallback(ProgressCallback callback) {
+	this->callback = std::move(callback);
+}
+
+void LayoutRunner::Start() {
+	checkNotRunning();
+	Wait(); // a thread that stopped on its own is still joinable
+	isCancelled = false;
+	isRunning = true;
+	isStarted = true;
+	progress.isSettled = false; // edges may have arrived, or the graph been reloaded, since it settled
+	thread = std::thread([this]() {
+		TRACE_THREAD_NAME("layout");
+		while (!isCancelled) {
+			{
+				std::unique_lock<std::mutex> guard(stateLock);
+				stateChanged.wait(guard, [this]() { return !isPaused || isCancelled; });
+			}
+			if (isCancelled || !step()) {
+				break;
+			}
+		}
+		isRunning = false;
+	});
+}
+
+void LayoutRunner::Pause() {
+	std::lock_guard<std::mutex> guard(stateLock);
+	isPaused = true;
+}
+
+void LayoutRunner::Resume() {
+	{
+		std::lock_guard<std::mutex> guard(stateLock);
+		isPaused = false;
+	}
+	stateChanged.notify_all();
+	if (isStarted && !isRunning && !isCancelled) { // the thread stopped once the layout settled
+		Start();
+	}
+}
+
+void LayoutRunner::Cancel() {
+	{
+		std::lock_guard<std::mutex> guard(stateLock);
+		isCancelled = true;
+	}
+	stateChanged.notify_all();
+}
+
+void LayoutRunner::Wait() {
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+
+bool LayoutRunner::IsRunning() const {
+	return isRunning;
+}
+
+bool LayoutRunner::IsPaused() const {
+	return isPaused;
+}
+
+LayoutRunner::Progress LayoutRunner::RunFor(Clock::time_point deadline) {
+	checkNotRunning();
+	for (bool isFirst = true; (isFirst || !progress.isSettled) && Clock::now() + lastStep <= deadline; isFirst = false) { // the first step tells whether it is still settled
+		step();
+	}
+	return progress;
+}
+
+LayoutRunner::Progress LayoutRunner::RunIterations(size_t count) {
+	checkNotRunning();
+	for (size_t i = 0; i < count && (i == 0 || !progress.isSettled); ++i) {
+		step();
+	}
+	return progress;
+}
+
+bool LayoutRunner::step() {
+	TRACE_SCOPE("LayoutRunner step");
+	auto start = Clock::now();
+	progress.change = graph.ApplyForce();
+	lastStep = Clock::now() - start;
+	++progress.iterations;
+	progress.isSettled = progress.change < stableThreshold && !graph.IsLoading(); // edges still to come will move the vertices again
+	if (callback) {
+		callback(progress);
+	}
+	return !progress.isSettled;
+}
+
+void LayoutRunner::checkNotRunning() const {
+	if (isRunning) {
+		throw std::logic_error{ "LayoutRunner: the layout thread is running" };
+	}
+}
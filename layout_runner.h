@@ -0,0 +1,52 @@
+#pragma once
+#include "graph.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+class LayoutRunner { // drives Graph::ApplyForce, either on a thread of its own or in budgeted slices on the caller's thread
+public:
+	struct Progress {
+		size_t iterations = 0; // steps run by this runner so far
+		double change = 0; // ApplyForce result of the last step
+		bool isSettled = false; // the last step moved the vertices less than stableThreshold
+	};
+	using ProgressCallback = std::function<void(const Progress& progress)>;
+	using Clock = std::chrono::steady_clock;
+private:
+	Graph& graph;
+	ProgressCallback callback;
+	std::thread thread;
+	std::mutex stateLock;
+	std::condition_variable stateChanged;
+	std::atomic<bool> isPaused{ false };
+	std::atomic<bool> isCancelled{ false };
+	std::atomic<bool> isRunning{ false };
+	bool isStarted = false; // Start was called, so Resume may need to start the thread again
+	Progress progress; // written only by whoever runs the steps
+	Clock::duration lastStep{}; // how long the last step took, to tell whether another one fits a budget
+public:
+	explicit LayoutRunner(Graph& graph);
+	~LayoutRunner(); // cancels and waits for the thread
+	LayoutRunner(const LayoutRunner&) = delete;
+	LayoutRunner& operator=(const LayoutRunner&) = delete;
+	void SetProgressCallback(ProgressCallback callback); // called after every step, on the thread that ran it; set before running
+	void Start(); // steps on a thread of its own until the layout settles or Cancel is called
+	void Pause(); // the thread stops between two steps until Resume or Cancel
+	void Resume(); // also starts the thread again if it stopped because the layout settled
+	void Cancel(); // the thread stops after the current step; Wait to be sure it has
+	void Wait();
+	bool IsRunning() const; // the thread has started and not yet stopped
+	bool IsPaused() const;
+	// Step on the calling thread until the layout settles, always at least once, since edges may have arrived since it
+	// settled. RunFor skips a step that the last one's duration says would end past deadline; both throw
+	// std::logic_error while the thread is running.
+	Progress RunFor(Clock::time_point deadline);
+	Progress RunIterations(size_t count);
+private:
+	bool step(); // one ApplyForce, reported to the callback; false once the layout has settled
+	void checkNotRunning() const;
+};
@@ -0,0 +1,90 @@
+#include "mapped_file.h"
+#include <stdexcept>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& filename) {
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error{ "cannot open " + filename };
+	}
+	fileHandle = file;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		throw std::runtime_error{ "cannot get size of " + filename };
+	}
+	size = static_cast<size_t>(fileSize.QuadPart);
+	if (size == 0) {
+		return;
+	}
+	mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mappingHandle) {
+		CloseHandle(file);
+		throw std::runtime_error{ "cannot map " + filename };
+	}
+	data = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (!data) {
+		CloseHandle(mappingHandle);
+		CloseHandle(file);
+		throw std::runtime_error{ "cannot map " + filename };
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (data) {
+		UnmapViewOfFile(data);
+	}
+	if (mappingHandle) {
+		CloseHandle(mappingHandle);
+	}
+	if (fileHandle) {
+		CloseHandle(fileHandle);
+	}
+}
+#else
+MappedFile::MappedFile(const std::string& filename) {
+	fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error{ "cannot open " + filename };
+	}
+	struct stat fileStat;
+	if (fstat(fd, &fileStat)) {
+		close(fd);
+		throw std::runtime_error{ "cannot get size of " + filename };
+	}
+	size = static_cast<size_t>(fileStat.st_size);
+	if (size == 0) {
+		return;
+	}
+	void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (mapping == MAP_FAILED) {
+		close(fd);
+		throw std::runtime_error{ "cannot map " + filename };
+	}
+	madvise(mapping, size, MADV_SEQUENTIAL);
+	data = static_cast<const char*>(mapping);
+}
+
+MappedFile::~MappedFile() {
+	if (data) {
+		munmap(const_cast<char*>(data), size);
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+}
+#endif
+
+std::string_view MappedFile::View() const {
+	return { data, size };
+}
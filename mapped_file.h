@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+class MappedFile { // read-only memory mapping of a whole file
+private:
+	const char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fd = -1;
+#endif
+public:
+	explicit MappedFile(const std::string& filename);
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	std::string_view View() const;
+	~MappedFile();
+};
@@ -0,0 +1,124 @@
+#include "perf_counters.h"
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+namespace {
+	struct EventConfig {
+		uint32_t type;
+		uint64_t config;
+	};
+
+	constexpr EventConfig configs[PerfCounters::eventCount] = {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES }
+	};
+
+	int OpenEvent(const EventConfig& event) {
+		perf_event_attr attr{};
+		attr.size = sizeof(attr);
+		attr.type = event.type;
+		attr.config = event.config;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attr.inherit = 1; // threads started later count too; reads add up the threads still running
+		attr.exclude_kernel = 1; // also keeps the counters usable at the default perf_event_paranoid level
+		attr.exclude_hv = 1;
+		return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+	}
+}
+#endif
+
+PerfCounters::PerfCounters() {
+	fds.fill(-1);
+#ifdef __linux__
+	for (size_t event = 0; event < eventCount; ++event) {
+		fds[event] = OpenEvent(configs[event]);
+		if (fds[event] < 0 && error.empty()) {
+			error = std::string{ "perf_event_open failed for " } + Name(static_cast<Event>(event)) + ": " + std::strerror(errno);
+		}
+	}
+#else
+	error = "hardware counters are read through Linux perf_event_open";
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+	for (int fd : fds) {
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+#endif
+}
+
+const char* PerfCounters::Name(Event event) {
+	switch (event) {
+	case Cycles:
+		return "cycles";
+	case Instructions:
+		return "instructions";
+	case L1Misses:
+		return "L1d misses";
+	case LlcMisses:
+		return "LLC misses";
+	case BranchMisses:
+		return "branch misses";
+	default:
+		return "unknown";
+	}
+}
+
+bool PerfCounters::IsAvailable(Event event) const {
+	return fds[event] >= 0;
+}
+
+bool PerfCounters::IsAnyAvailable() const {
+	for (int fd : fds) {
+		if (fd >= 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+const std::string& PerfCounters::Error() const {
+	return error;
+}
+
+PerfCounters::Values PerfCounters::Read() const {
+	Values values{};
+#ifdef __linux__
+	for (size_t event = 0; event < eventCount; ++event) {
+		uint64_t data[3] = {}; // value, time enabled, time running
+		if (fds[event] < 0 || read(fds[event], data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+			continue;
+		}
+		values[event] = data[2] < data[1] ? static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]) : data[0];
+	}
+#endif
+	return values;
+}
+
+PerfCounters::Values operator-(const PerfCounters::Values& lhs, const PerfCounters::Values& rhs) {
+	PerfCounters::Values result;
+	for (size_t i = 0; i < result.size(); ++i) {
+		result[i] = lhs[i] > rhs[i] ? lhs[i] - rhs[i] : 0; // scaled totals may step back a little
+	}
+	return result;
+}
+
+PerfCounters::Values& operator+=(PerfCounters::Values& lhs, const PerfCounters::Values& rhs) {
+	for (size_t i = 0; i < lhs.size(); ++i) {
+		lhs[i] += rhs[i];
+	}
+	return lhs;
+}
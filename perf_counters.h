@@ -0,0 +1,36 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class PerfCounters { // hardware counters through Linux perf_event_open; elsewhere nothing is available and every value stays 0
+public:
+	enum Event {
+		Cycles,
+		Instructions,
+		L1Misses, // level 1 data cache read misses
+		LlcMisses, // last level cache misses
+		BranchMisses,
+		eventCount
+	};
+	using Values = std::array<uint64_t, eventCount>;
+private:
+	std::array<int, eventCount> fds;
+	std::string error; // why the first unavailable event could not be opened
+public:
+	// Counts the calling thread and the threads it starts afterwards, in user space only, so construct it before the
+	// work to measure starts its threads (the shared thread pool starts its workers when first used).
+	PerfCounters();
+	~PerfCounters();
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+	static const char* Name(Event event);
+	bool IsAvailable(Event event) const;
+	bool IsAnyAvailable() const;
+	const std::string& Error() const;
+	Values Read() const; // totals since construction, scaled up when the kernel had to share counters between events
+};
+
+PerfCounters::Values operator-(const PerfCounters::Values& lhs, const PerfCounters::Values& rhs);
+PerfCounters::Values& operator+=(PerfCounters::Values& lhs, const PerfCounters::Values& rhs);
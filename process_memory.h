@@ -0,0 +1,4 @@
+#pragma once
+#include <cstddef>
+
+size_t ResidentMemoryBytes(); // physical memory the process uses right now, 0 where it cannot be found out
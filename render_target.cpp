@@ -0,0 +1,93 @@
+#include "render_target.h"
+#include <algorithm>
+#include <cmath>
+
+constexpr double minZoom = 1.0;
+constexpr double maxZoom = 4096.0;
+
+RenderTarget::RenderTarget(int width, int height) : width{ width }, height{ height } {}
+
+void RenderTarget::FitTo(const Area& area) {
+	updateTarget(std::floor(area.minX), std::floor(area.minY), std::ceil(area.maxX), std::ceil(area.maxY));
+}
+
+RenderTarget::Area RenderTarget::VisibleArea() const {
+	return { -offset_x / scale, -offset_y / scale, (width - offset_x) / scale, (height - offset_y) / scale };
+}
+
+size_t RenderTarget::ViewVersion() const {
+	return viewVersion;
+}
+
+int RenderTarget::Width() const {
+	return width;
+}
+
+int RenderTarget::Height() const {
+	return height;
+}
+
+void RenderTarget::updateTarget(int minX, int minY, int maxX, int maxY)
+{
+	if (!has_target)
+	{
+		target_min_x = minX;
+		target_max_x = maxX;
+		target_min_y = minY;
+		target_max_y = maxY;
+	}
+	has_target = true;
+	if (target_min_x > minX)
+	{
+		target_min_x = minX;
+	}
+	if (target_max_x < maxX)
+	{
+		target_max_x = maxX;
+	}
+	if (target_min_y > minY)
+	{
+		target_min_y = minY;
+	}
+	if (target_max_y < maxY)
+	{
+		target_max_y = maxY;
+	}
+}
+
+void RenderTarget::updateView() {
+	if (has_target)
+	{
+		double oldScale = scale;
+		double oldOffsetX = offset_x;
+		double oldOffsetY = offset_y;
+		scale = zoom * std::min(width / ((target_max_x - target_min_x)), height / ((target_max_y - target_min_y)));
+		offset_x = width / 2.0 - ((target_min_x + target_max_x) / 2 + pan_x) * scale;
+		offset_y = height / 2.0 - ((target_min_y + target_max_y) / 2 + pan_y) * scale;
+		if (scale != oldScale || offset_x != oldOffsetX || offset_y != oldOffsetY) {
+			++viewVersion;
+		}
+	}
+	has_target = false;
+}
+
+void RenderTarget::zoomAt(double factor, int x, int y) {
+	double newZoom = std::clamp(zoom * factor, minZoom, maxZoom);
+	factor = newZoom / zoom;
+	zoom = newZoom;
+	// keep the point under (x, y) in place
+	double centerShiftX = (x - width / 2.0) / scale;
+	double centerShiftY = (y - height / 2.0) / scale;
+	pan_x += centerShiftX - centerShiftX / factor;
+	pan_y += centerShiftY - centerShiftY / factor;
+	offset_x = x - (x - offset_x) * factor;
+	offset_y = y - (y - offset_y) * factor;
+	scale *= factor;
+	++viewVersion;
+}
+
+void RenderTarget::resetView() {
+	zoom = 1.0;
+	pan_x = pan_y = 0;
+	++viewVersion;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+class RenderTarget { // surface the graph can be drawn on; keeps the view that fits the drawing into it
+public:
+	struct Color {
+		unsigned char r;
+		unsigned char g;
+		unsigned char b;
+	};
+	struct Point {
+		double x;
+		double y;
+	};
+	struct Line {
+		double x0;
+		double y0;
+		double x1;
+		double y1;
+		Color color;
+	};
+	struct Rectangle {
+		double x0;
+		double y0;
+		double x1;
+		double y1;
+	};
+	struct Area {
+		double minX;
+		double minY;
+		double maxX;
+		double maxY;
+	};
+protected:
+	int width;
+	int height;
+	double offset_x = 0;
+	double offset_y = 0;
+	double scale = 1.0;
+	double zoom = 1.0;
+	double pan_x = 0; // view center relative to the center of the fitted target, in drawing coordinates
+	double pan_y = 0;
+	double target_max_x;
+	double target_min_x;
+	double target_max_y;
+	double target_min_y;
+	bool has_target = false;
+	size_t viewVersion = 0;
+public:
+	RenderTarget(int width, int height);
+	virtual void DrawLine(int x0, int y0, int x1, int y1) = 0;
+	virtual void DrawRectangle(int x0, int y0, int x1, int y1) = 0;
+	virtual void DrawLines(const std::vector<Line>& lines) = 0; // draws a batch of segments; skips sub-pixel ones
+	virtual void DrawRectangles(const std::vector<Rectangle>& rectangles, Color color) = 0; // draws a batch of rectangle outlines
+	virtual void DrawImage(const std::vector<uint32_t>& pixels) = 0; // covers the whole target with a Width() x Height() RGBA image, red in the lowest byte
+	virtual void SetDrawColor(unsigned char r, unsigned char g, unsigned char b) = 0;
+	virtual void Clear() = 0;
+	virtual void Update() = 0; // finishes the frame and moves the view to fit what was drawn
+	void FitTo(const Area& area); // makes the view fit area at zoom 1; batch calls do not move the view by themselves
+	Area VisibleArea() const; // part of the drawing coordinates currently on screen
+	size_t ViewVersion() const; // changes whenever zoom, pan or the fitted transform change
+	int Width() const;
+	int Height() const;
+	virtual ~RenderTarget() = default;
+protected:
+	void updateTarget(int minX, int minY, int maxX, int maxY);
+	void updateView(); // applies the collected target, zoom and pan to the transform
+	void zoomAt(double factor, int x, int y); // zooms keeping screen point (x, y) in place
+	void resetView();
+};
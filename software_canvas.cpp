@@ -0,0 +1,442 @@
+#include "software_canvas.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CANVAS_USE_SSE2
+#endif
+
+namespace {
+	constexpr int tileSize = 64;
+	constexpr double binMargin = 2.0; // pixels a segment's raster can reach beyond the segment itself
+	constexpr size_t minParallelItems = 4096; // smaller batches are not worth waking other threads for
+
+	uint32_t Pack(RenderTarget::Color color) {
+		return 0xFF000000u | (static_cast<uint32_t>(color.b) << 16) | (static_cast<uint32_t>(color.g) << 8) | color.r;
+	}
+
+	int TileOf(double coordinate, int tileCount) {
+		return std::clamp(static_cast<int>(std::floor(coordinate / tileSize)), 0, tileCount - 1);
+	}
+
+	void FillPixels(uint32_t* data, size_t count, uint32_t color) {
+#ifdef CANVAS_USE_SSE2
+		__m128i value = _mm_set1_epi32(static_cast<int>(color));
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), value);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i + 4), value);
+		}
+		for (; i < count; ++i) {
+			data[i] = color;
+		}
+#else
+		std::fill_n(data, count, color);
+#endif
+	}
+
+	uint32_t BlendPixel(uint32_t destination, uint32_t source, uint32_t alpha) { // alpha of source out of 256; the result is opaque
+#ifdef CANVAS_USE_SSE2
+		__m128i zero = _mm_setzero_si128(); // the channels are widened to 16 bits and blended side by side
+		__m128i wideDestination = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(destination)), zero);
+		__m128i wideSource = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(source)), zero);
+		__m128i sum = _mm_add_epi16(_mm_mullo_epi16(wideDestination, _mm_set1_epi16(static_cast<short>(256 - alpha))), _mm_mullo_epi16(wideSource, _mm_set1_epi16(static_cast<short>(alpha))));
+		__m128i result = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8); // at most 255 * 256 + 128, so nothing wraps
+		return 0xFF000000u | static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(result, zero)));
+#else
+		uint32_t result = 0xFF000000u;
+		for (int shift = 0; shift < 24; shift += 8) {
+			uint32_t from = (destination >> shift) & 0xFF;
+			uint32_t to = (source >> shift) & 0xFF;
+			result |= ((from * (256 - alpha) + to * alpha + 128) >> 8) << shift;
+		}
+		return result;
+#endif
+	}
+
+	// Liang-Barsky clipping of a segment to [minX, maxX] x [minY, maxY]; false if nothing is left
+	bool ClipLine(double& x0, double& y0, double& x1, double& y1, double minX, double minY, double maxX, double maxY) {
+		double dx = x1 - x0;
+		double dy = y1 - y0;
+		double t0 = 0;
+		double t1 = 1;
+		const double p[] = { -dx, dx, -dy, dy };
+		const double q[] = { x0 - minX, maxX - x0, y0 - minY, maxY - y0 };
+		for (int i = 0; i < 4; ++i) {
+			if (p[i] == 0) {
+				if (q[i] < 0) {
+					return false;
+				}
+				continue;
+			}
+			double t = q[i] / p[i];
+			if (p[i] < 0) {
+				t0 = std::max(t0, t);
+			} else {
+				t1 = std::min(t1, t);
+			}
+			if (t0 > t1) {
+				return false;
+			}
+		}
+		x1 = x0 + t1 * dx;
+		y1 = y0 + t1 * dy;
+		x0 += t0 * dx;
+		y0 += t0 * dy;
+		return true;
+	}
+
+	void PutBigEndian(std::string& output, uint32_t value) {
+		output.push_back(static_cast<char>(value >> 24));
+		output.push_back(static_cast<char>(value >> 16));
+		output.push_back(static_cast<char>(value >> 8));
+		output.push_back(static_cast<char>(value));
+	}
+
+	uint32_t Crc32(const std::string& data, size_t from) {
+		static const auto table = []() {
+			std::vector<uint32_t> result(256);
+			for (uint32_t n = 0; n < 256; ++n) {
+				uint32_t c = n;
+				for (int k = 0; k < 8; ++k) {
+					c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+				result[n] = c;
+			}
+			return result;
+		}();
+		uint32_t crc = 0xFFFFFFFFu;
+		for (size_t i = from; i < data.size(); ++i) {
+			crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+		}
+		return crc ^ 0xFFFFFFFFu;
+	}
+
+	void PutChunk(std::string& output, const char* type, const std::string& data) {
+		PutBigEndian(output, static_cast<uint32_t>(data.size()));
+		size_t typeStart = output.size();
+		output.append(type, 4);
+		output += data;
+		PutBigEndian(output, Crc32(output, typeStart));
+	}
+
+	std::string EncodePng(const std::vector<uint32_t>& pixels, int width, int height) { // RGB, stored (uncompressed) deflate blocks
+		std::string raw;
+		raw.reserve(static_cast<size_t>(height) * (width * 3 + 1));
+		for (int y = 0; y < height; ++y) {
+			raw.push_back(0); // no filter
+			for (int x = 0; x < width; ++x) {
+				uint32_t pixel = pixels[static_cast<size_t>(y) * width + x];
+				raw.push_back(static_cast<char>(pixel));
+				raw.push_back(static_cast<char>(pixel >> 8));
+				raw.push_back(static_cast<char>(pixel >> 16));
+			}
+		}
+
+		std::string zlib{ "\x78\x01", 2 };
+		constexpr size_t maxBlock = 65535;
+		for (size_t pos = 0; pos < raw.size() || pos == 0; pos += maxBlock) {
+			size_t length = std::min(maxBlock, raw.size() - pos);
+			zlib.push_back(pos + length >= raw.size() ? 1 : 0);
+			zlib.push_back(static_cast<char>(length & 0xFF));
+			zlib.push_back(static_cast<char>(length >> 8));
+			zlib.push_back(static_cast<char>(~length & 0xFF));
+			zlib.push_back(static_cast<char>((~length >> 8) & 0xFF));
+			zlib.append(raw, pos, length);
+			if (raw.empty()) {
+				break;
+			}
+		}
+		uint32_t a = 1;
+		uint32_t b = 0;
+		for (unsigned char c : raw) {
+			a = (a + c) % 65521;
+			b = (b + a) % 65521;
+		}
+		PutBigEndian(zlib, (b << 16) | a);
+
+		std::string header;
+		PutBigEndian(header, width);
+		PutBigEndian(header, height);
+		header += std::string{ "\x08\x02\x00\x00\x00", 5 }; // 8 bit RGB, no interlace
+
+		std::string png{ "\x89PNG\r\n\x1A\n", 8 };
+		PutChunk(png, "IHDR", header);
+		PutChunk(png, "IDAT", zlib);
+		PutChunk(png, "IEND", "");
+		return png;
+	}
+}
+
+SoftwareCanvas::SoftwareCanvas(int width, int height, bool isAntialiased)
+	: RenderTarget(width, height), pixels(static_cast<size_t>(width) * height, drawColor), isAntialiased{ isAntialiased } {}
+
+void SoftwareCanvas::DrawLine(int x0, int y0, int x1, int y1) {
+	Line line{ offset_x + x0 * scale, offset_y + y0 * scale, offset_x + x1 * scale, offset_y + y1 * scale, {} };
+	if (ClipLine(line.x0, line.y0, line.x1, line.y1, 0, 0, width - 1, height - 1)) {
+		line.color = { static_cast<unsigned char>(drawColor), static_cast<unsigned char>(drawColor >> 8), static_cast<unsigned char>(drawColor >> 16) };
+		rasterLine(line, wholeCanvas());
+	}
+	updateTarget(x0, y0, x1, y1);
+}
+
+void SoftwareCanvas::DrawRectangle(int x0, int y0, int x1, int y1) {
+	int x = static_cast<int>(offset_x + x0 * scale);
+	int y = static_cast<int>(offset_y + y0 * scale);
+	int w = static_cast<int>((x1 - x0) * scale);
+	int h = static_cast<int>((y1 - y0) * scale);
+	rasterRectangle({ x, y, x + w - 1, y + h - 1 }, drawColor, wholeCanvas());
+	updateTarget(x0, y0, x1, y1);
+}
+
+void SoftwareCanvas::DrawLines(const std::vector<Line>& lines) {
+	screenLines.clear();
+	for (const auto& line : lines) {
+		Line screen{ offset_x + line.x0 * scale, offset_y + line.y0 * scale, offset_x + line.x1 * scale, offset_y + line.y1 * scale, line.color };
+		if (ClipLine(screen.x0, screen.y0, screen.x1, screen.y1, 0, 0, width - 1, height - 1)) {
+			screenLines.push_back(screen);
+		}
+	}
+	if (!lines.empty()) {
+		SetDrawColor(lines.back().color.r, lines.back().color.g, lines.back().color.b);
+	}
+
+	// Walks the tile columns the segment crosses. Rounding to the nearest pixel reaches half a pixel past the segment's ends,
+	// and antialiasing one more pixel to the side, hence the margin.
+	auto bin = [this](size_t index, int columns, int rows, auto add) {
+		const Line& line = screenLines[index];
+		double minX = std::min(line.x0, line.x1);
+		double maxX = std::max(line.x0, line.x1);
+		double slope = maxX - minX > 1e-9 ? (line.y1 - line.y0) / (line.x1 - line.x0) : 0;
+		for (int column = TileOf(minX - binMargin, columns); column <= TileOf(maxX + binMargin, columns); ++column) {
+			double left = std::clamp(column * tileSize - binMargin, minX, maxX);
+			double right = std::clamp((column + 1) * tileSize + binMargin, minX, maxX);
+			double yLeft = maxX - minX > 1e-9 ? line.y0 + (left - line.x0) * slope : line.y0;
+			double yRight = maxX - minX > 1e-9 ? line.y0 + (right - line.x0) * slope : line.y1;
+			for (int row = TileOf(std::min(yLeft, yRight) - binMargin, rows); row <= TileOf(std::max(yLeft, yRight) + binMargin, rows); ++row) {
+				add(column, row);
+			}
+		}
+	};
+	rasterTiled(screenLines.size(), bin, [this](size_t index, const PixelBox& clip) { rasterLine(screenLines[index], clip); });
+}
+
+void SoftwareCanvas::DrawRectangles(const std::vector<Rectangle>& rectangles, Color color) {
+	SetDrawColor(color.r, color.g, color.b);
+	screenRectangles.clear();
+	for (const auto& rectangle : rectangles) {
+		int x = static_cast<int>(offset_x + rectangle.x0 * scale);
+		int y = static_cast<int>(offset_y + rectangle.y0 * scale);
+		int w = static_cast<int>((rectangle.x1 - rectangle.x0) * scale);
+		int h = static_cast<int>((rectangle.y1 - rectangle.y0) * scale);
+		PixelBox box{ x, y, x + std::max(w, 1) - 1, y + std::max(h, 1) - 1 };
+		if (box.maxX >= 0 && box.maxY >= 0 && box.minX < width && box.minY < height) {
+			screenRectangles.push_back({ x, y, x + w - 1, y + h - 1 });
+		}
+	}
+
+	auto bin = [this](size_t index, int columns, int rows, auto add) {
+		const PixelBox& box = screenRectangles[index];
+		for (int row = TileOf(box.minY, rows); row <= TileOf(std::max(box.minY, box.maxY), rows); ++row) {
+			for (int column = TileOf(box.minX, columns); column <= TileOf(std::max(box.minX, box.maxX), columns); ++column) {
+				add(column, row);
+			}
+		}
+	};
+	uint32_t packed = Pack(color);
+	rasterTiled(screenRectangles.size(), bin, [this, packed](size_t index, const PixelBox& clip) { rasterRectangle(screenRectangles[index], packed, clip); });
+}
+
+void SoftwareCanvas::DrawImage(const std::vector<uint32_t>& pixels) {
+	std::copy_n(pixels.begin(), std::min(pixels.size(), this->pixels.size()), this->pixels.begin());
+}
+
+void SoftwareCanvas::SetDrawColor(unsigned char r, unsigned char g, unsigned char b) {
+	drawColor = Pack({ r, g, b });
+}
+
+void SoftwareCanvas::Clear() {
+	FillPixels(pixels.data(), pixels.size(), drawColor);
+}
+
+void SoftwareCanvas::Update() {
+	if (!sequencePrefix.empty()) {
+		char number[16];
+		std::snprintf(number, sizeof(number), "%05zu", frameNumber);
+		Save(sequencePrefix + number + (sequenceFormat == ImageFormat::Png ? ".png" : ".ppm"), sequenceFormat);
+	}
+	++frameNumber;
+	updateView();
+}
+
+void SoftwareCanvas::RecordFrames(const std::string& prefix, ImageFormat format) {
+	sequencePrefix = prefix;
+	sequenceFormat = format;
+	frameNumber = 0;
+}
+
+void SoftwareCanvas::SetThreadCount(size_t count) {
+	threadCount = count;
+}
+
+void SoftwareCanvas::Save(const std::string& filename, ImageFormat format) const {
+	std::ofstream out(filename, std::ios::binary);
+	if (!out) {
+		throw std::runtime_error{ "cannot write " + filename };
+	}
+	if (format == ImageFormat::Png) {
+		std::string png = EncodePng(pixels, width, height);
+		out.write(png.data(), png.size());
+		return;
+	}
+	out << "P6\n" << width << ' ' << height << "\n255\n";
+	std::string row(static_cast<size_t>(width) * 3, '\0');
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			uint32_t pixel = pixels[static_cast<size_t>(y) * width + x];
+			row[x * 3] = static_cast<char>(pixel);
+			row[x * 3 + 1] = static_cast<char>(pixel >> 8);
+			row[x * 3 + 2] = static_cast<char>(pixel >> 16);
+		}
+		out.write(row.data(), row.size());
+	}
+}
+
+const std::vector<uint32_t>& SoftwareCanvas::Pixels() const {
+	return pixels;
+}
+
+SoftwareCanvas::ImageFormat SoftwareCanvas::FormatOf(const std::string& filename) {
+	return std::filesystem::path(filename).extension() == ".ppm" ? ImageFormat::Ppm : ImageFormat::Png;
+}
+
+SoftwareCanvas::PixelBox SoftwareCanvas::wholeCanvas() const {
+	return { 0, 0, width - 1, height - 1 };
+}
+
+void SoftwareCanvas::plot(int x, int y, uint32_t color, const PixelBox& clip) {
+	if (x >= clip.minX && y >= clip.minY && x <= clip.maxX && y <= clip.maxY) {
+		pixels[static_cast<size_t>(y) * width + x] = color;
+	}
+}
+
+void SoftwareCanvas::blend(int x, int y, uint32_t color, double coverage, const PixelBox& clip) {
+	if (x < clip.minX || y < clip.minY || x > clip.maxX || y > clip.maxY) {
+		return;
+	}
+	uint32_t& pixel = pixels[static_cast<size_t>(y) * width + x];
+	pixel = BlendPixel(pixel, color, static_cast<uint32_t>(coverage * 256 + 0.5));
+}
+
+void SoftwareCanvas::fillSpan(int y, int x0, int x1, uint32_t color, const PixelBox& clip) {
+	if (y < clip.minY || y > clip.maxY) {
+		return;
+	}
+	x0 = std::max(x0, clip.minX);
+	x1 = std::min(x1, clip.maxX);
+	if (x0 <= x1) {
+		FillPixels(pixels.data() + static_cast<size_t>(y) * width + x0, x1 - x0 + 1, color);
+	}
+}
+
+void SoftwareCanvas::rasterLine(const Line& line, const PixelBox& clip) {
+	// Steps along the major axis and computes the minor coordinate from the line equation rather than
+	// accumulating it, so every tile produces exactly the pixels the whole line would have there.
+	// Without antialiasing this picks the same pixels as Bresenham's algorithm; with it, it is Xiaolin Wu's.
+	uint32_t color = Pack(line.color);
+	double x0 = line.x0;
+	double y0 = line.y0;
+	double x1 = line.x1;
+	double y1 = line.y1;
+	bool isSteep = std::abs(y1 - y0) > std::abs(x1 - x0);
+	if (isSteep) {
+		std::swap(x0, y0);
+		std::swap(x1, y1);
+	}
+	if (x0 > x1) {
+		std::swap(x0, x1);
+		std::swap(y0, y1);
+	}
+	auto put = [this, isSteep, color, &clip](int major, int minor, double coverage) {
+		int x = isSteep ? minor : major;
+		int y = isSteep ? major : minor;
+		if (!isAntialiased) {
+			plot(x, y, color, clip);
+		} else if (coverage > 0) {
+			blend(x, y, color, coverage, clip);
+		}
+	};
+	double gradient = x1 - x0 == 0 ? 0 : (y1 - y0) / (x1 - x0);
+	int first = std::max<int>(std::lround(x0), isSteep ? clip.minY : clip.minX);
+	int last = std::min<int>(std::lround(x1), isSteep ? clip.maxY : clip.maxX);
+	for (int x = first; x <= last; ++x) {
+		double y = y0 + gradient * (x - x0);
+		if (!isAntialiased) {
+			put(x, std::lround(y), 1);
+			continue;
+		}
+		int base = static_cast<int>(std::floor(y));
+		double fraction = y - base;
+		put(x, base, 1 - fraction);
+		put(x, base + 1, fraction);
+	}
+}
+
+void SoftwareCanvas::rasterRectangle(const PixelBox& rectangle, uint32_t color, const PixelBox& clip) {
+	if (rectangle.maxX <= rectangle.minX || rectangle.maxY <= rectangle.minY) {
+		plot(rectangle.minX, rectangle.minY, color, clip);
+		return;
+	}
+	fillSpan(rectangle.minY, rectangle.minX, rectangle.maxX, color, clip);
+	fillSpan(rectangle.maxY, rectangle.minX, rectangle.maxX, color, clip);
+	for (int row = std::max(rectangle.minY + 1, clip.minY); row <= std::min(rectangle.maxY - 1, clip.maxY); ++row) {
+		plot(rectangle.minX, row, color, clip);
+		plot(rectangle.maxX, row, color, clip);
+	}
+}
+
+template<typename Bin, typename Raster>
+void SoftwareCanvas::rasterTiled(size_t count, Bin bin, Raster raster) {
+	ThreadPool& pool = ThreadPool::Shared();
+	size_t threads = threadCount ? std::min(threadCount, pool.Concurrency()) : pool.Concurrency();
+	if (count < minParallelItems || threads < 2) {
+		for (size_t i = 0; i < count; ++i) {
+			raster(i, wholeCanvas());
+		}
+		return;
+	}
+
+	// Every pixel belongs to one tile and every tile to one thread, so the framebuffer needs no locking.
+	// Items keep their order inside a tile, which makes the result identical to drawing them one by one.
+	int columns = (width + tileSize - 1) / tileSize;
+	int rows = (height + tileSize - 1) / tileSize;
+	size_t tileCount = static_cast<size_t>(columns) * rows;
+	tileStarts.assign(tileCount + 1, 0);
+	for (size_t i = 0; i < count; ++i) {
+		bin(i, columns, rows, [this, columns](int column, int row) { ++tileStarts[static_cast<size_t>(row) * columns + column + 1]; });
+	}
+	for (size_t tile = 0; tile < tileCount; ++tile) {
+		tileStarts[tile + 1] += tileStarts[tile];
+	}
+	tileItems.resize(tileStarts.back());
+	tileFill.assign(tileStarts.begin(), tileStarts.end() - 1);
+	for (size_t i = 0; i < count; ++i) {
+		bin(i, columns, rows, [this, columns, i](int column, int row) { tileItems[tileFill[static_cast<size_t>(row) * columns + column]++] = i; });
+	}
+
+	pool.ParallelFor(tileCount, 1, [&](size_t begin, size_t end) {
+		for (size_t tile = begin; tile < end; ++tile) {
+			int column = static_cast<int>(tile % columns);
+			int row = static_cast<int>(tile / columns);
+			PixelBox clip{ column * tileSize, row * tileSize, std::min((column + 1) * tileSize, width) - 1, std::min((row + 1) * tileSize, height) - 1 };
+			for (size_t k = tileStarts[tile]; k < tileStarts[tile + 1]; ++k) {
+				raster(tileItems[k], clip);
+			}
+		}
+	}, threads, ThreadPool::Priority::High);
+}
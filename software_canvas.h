@@ -0,0 +1,55 @@
+#pragma once
+#include "render_target.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+class SoftwareCanvas : public RenderTarget { // draws into an in-memory RGBA framebuffer; needs neither a display nor SDL
+public:
+	enum class ImageFormat {
+		Ppm,
+		Png
+	};
+private:
+	uint32_t drawColor = 0xFF000000; // declared before pixels, which are filled with it
+	std::vector<uint32_t> pixels; // row-major, red in the lowest byte
+	bool isAntialiased;
+	size_t threadCount = 0;
+	struct PixelBox { // inclusive pixel bounds
+		int minX;
+		int minY;
+		int maxX;
+		int maxY;
+	};
+	std::vector<Line> screenLines; // batch in pixel coordinates, clipped to the canvas
+	std::vector<PixelBox> screenRectangles;
+	std::vector<size_t> tileStarts; // tile bins in CSR form: items of tile t are tileItems[tileStarts[t]..tileStarts[t + 1])
+	std::vector<size_t> tileItems;
+	std::vector<size_t> tileFill;
+	std::string sequencePrefix; // when not empty, Update saves every frame
+	ImageFormat sequenceFormat = ImageFormat::Png;
+	size_t frameNumber = 0;
+public:
+	SoftwareCanvas(int width, int height, bool isAntialiased = false); // antialiased lines use Xiaolin Wu's algorithm, others Bresenham's
+	void DrawLine(int x0, int y0, int x1, int y1) override;
+	void DrawRectangle(int x0, int y0, int x1, int y1) override;
+	void DrawLines(const std::vector<Line>& lines) override;
+	void DrawRectangles(const std::vector<Rectangle>& rectangles, Color color) override;
+	void DrawImage(const std::vector<uint32_t>& pixels) override;
+	void SetDrawColor(unsigned char r, unsigned char g, unsigned char b) override;
+	void Clear() override;
+	void Update() override;
+	void RecordFrames(const std::string& prefix, ImageFormat format); // makes Update save frames as prefix00000.png, prefix00001.png, ...
+	void SetThreadCount(size_t count); // most threads of the shared pool rasterizing a large batch, 0 for all of them
+	void Save(const std::string& filename, ImageFormat format) const;
+	const std::vector<uint32_t>& Pixels() const;
+	static ImageFormat FormatOf(const std::string& filename); // by the extension of the file name, PNG unless it is .ppm
+private:
+	PixelBox wholeCanvas() const;
+	void plot(int x, int y, uint32_t color, const PixelBox& clip);
+	void blend(int x, int y, uint32_t color, double coverage, const PixelBox& clip);
+	void fillSpan(int y, int x0, int x1, uint32_t color, const PixelBox& clip);
+	void rasterLine(const Line& line, const PixelBox& clip); // pixel coordinates; only pixels inside clip are touched
+	void rasterRectangle(const PixelBox& rectangle, uint32_t color, const PixelBox& clip);
+	template<typename Bin, typename Raster>
+	void rasterTiled(size_t count, Bin bin, Raster raster); // bins items into screen tiles and rasterizes the tiles in parallel
+};
@@ -0,0 +1,141 @@
+#include "spatial_grid.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	constexpr int maxCellsPerSide = 1024;
+	constexpr int maxCellsPerItem = 16;
+	constexpr double itemsPerCell = 2;
+
+	bool Intersects(const SpatialGrid::Box& lhs, const SpatialGrid::Box& rhs) {
+		return lhs.minX <= rhs.maxX && rhs.minX <= lhs.maxX && lhs.minY <= rhs.maxY && rhs.minY <= lhs.maxY;
+	}
+}
+
+void SpatialGrid::Build(const std::vector<Box>& items) {
+	boxes = items;
+	seenStamp.assign(items.size(), 0);
+	queryStamp = 0;
+	longItems.clear();
+	if (items.empty()) {
+		bounds = { 0, 0, 0, 0 };
+		cellsX = cellsY = 0;
+		cellStart.assign(1, 0);
+		cellItems.clear();
+		return;
+	}
+
+	bounds = items.front();
+	for (const auto& box : items) {
+		bounds.minX = std::min(bounds.minX, box.minX);
+		bounds.minY = std::min(bounds.minY, box.minY);
+		bounds.maxX = std::max(bounds.maxX, box.maxX);
+		bounds.maxY = std::max(bounds.maxY, box.maxY);
+	}
+	double areaWidth = std::max(bounds.maxX - bounds.minX, 1e-9);
+	double areaHeight = std::max(bounds.maxY - bounds.minY, 1e-9);
+	double cellSize = std::sqrt(areaWidth * areaHeight * itemsPerCell / items.size());
+	cellsX = std::clamp(static_cast<int>(std::ceil(areaWidth / cellSize)), 1, maxCellsPerSide);
+	cellsY = std::clamp(static_cast<int>(std::ceil(areaHeight / cellSize)), 1, maxCellsPerSide);
+	cellWidth = areaWidth / cellsX;
+	cellHeight = areaHeight / cellsY;
+
+	cellStart.assign(static_cast<size_t>(cellsX) * cellsY + 1, 0);
+	auto forEachCell = [this](const Box& box, auto action) {
+		int x0 = CellX(box.minX);
+		int x1 = CellX(box.maxX);
+		int y0 = CellY(box.minY);
+		int y1 = CellY(box.maxY);
+		if ((x1 - x0 + 1) * (y1 - y0 + 1) > maxCellsPerItem) {
+			return false;
+		}
+		for (int y = y0; y <= y1; ++y) {
+			for (int x = x0; x <= x1; ++x) {
+				action(static_cast<size_t>(y) * cellsX + x);
+			}
+		}
+		return true;
+	};
+	for (const auto& box : items) {
+		forEachCell(box, [this](size_t cell) { ++cellStart[cell + 1]; });
+	}
+	for (size_t cell = 1; cell < cellStart.size(); ++cell) {
+		cellStart[cell] += cellStart[cell - 1];
+	}
+	cellItems.resize(cellStart.back());
+	std::vector<uint32_t> fill(cellStart.begin(), cellStart.end() - 1);
+	for (uint32_t item = 0; item < items.size(); ++item) {
+		if (!forEachCell(items[item], [this, &fill, item](size_t cell) { cellItems[fill[cell]++] = item; })) {
+			longItems.push_back(item);
+		}
+	}
+}
+
+template<typename Take>
+void SpatialGrid::ForEachCandidate(const Box& area, Take take) const {
+	int x0 = CellX(area.minX);
+	int x1 = CellX(area.maxX);
+	int y0 = CellY(area.minY);
+	int y1 = CellY(area.maxY);
+	for (int y = y0; y <= y1; ++y) {
+		for (int x = x0; x <= x1; ++x) {
+			size_t cell = static_cast<size_t>(y) * cellsX + x;
+			for (uint32_t i = cellStart[cell]; i < cellStart[cell + 1]; ++i) {
+				take(cellItems[i]);
+			}
+		}
+	}
+	for (uint32_t item : longItems) {
+		take(item);
+	}
+}
+
+void SpatialGrid::Query(const Box& area, std::vector<size_t>& result) {
+	if (boxes.empty() || !Intersects(area, bounds)) {
+		return;
+	}
+	if (++queryStamp == 0) {
+		std::fill(seenStamp.begin(), seenStamp.end(), 0);
+		queryStamp = 1;
+	}
+	size_t first = result.size();
+	ForEachCandidate(area, [this, &area, &result](uint32_t item) {
+		if (seenStamp[item] != queryStamp) {
+			seenStamp[item] = queryStamp;
+			if (Intersects(boxes[item], area)) {
+				result.push_back(item);
+			}
+		}
+	});
+	std::sort(result.begin() + first, result.end());
+}
+
+void SpatialGrid::Query(const Box& area, std::vector<size_t>& result, std::vector<char>& seen) const {
+	if (boxes.empty() || !Intersects(area, bounds)) {
+		return;
+	}
+	seen.resize(boxes.size(), 0);
+	size_t first = result.size();
+	ForEachCandidate(area, [this, &area, &result, &seen](uint32_t item) {
+		if (!seen[item]) {
+			seen[item] = 1;
+			if (Intersects(boxes[item], area)) {
+				result.push_back(item);
+			}
+		}
+	});
+	ForEachCandidate(area, [&seen](uint32_t item) { seen[item] = 0; });
+	std::sort(result.begin() + first, result.end());
+}
+
+const SpatialGrid::Box& SpatialGrid::Bounds() const {
+	return bounds;
+}
+
+int SpatialGrid::CellX(double x) const {
+	return static_cast<int>(std::clamp((x - bounds.minX) / cellWidth, 0.0, cellsX - 1.0));
+}
+
+int SpatialGrid::CellY(double y) const {
+	return static_cast<int>(std::clamp((y - bounds.minY) / cellHeight, 0.0, cellsY - 1.0));
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class SpatialGrid { // uniform grid over bounding boxes, answers "what intersects this area" without touching everything
+public:
+	struct Box {
+		double minX;
+		double minY;
+		double maxX;
+		double maxY;
+	};
+private:
+	Box bounds{ 0, 0, 0, 0 };
+	int cellsX = 0;
+	int cellsY = 0;
+	double cellWidth = 1;
+	double cellHeight = 1;
+	std::vector<uint32_t> cellStart; // items of cell c are cellItems[cellStart[c] .. cellStart[c + 1])
+	std::vector<uint32_t> cellItems;
+	std::vector<uint32_t> longItems; // items spanning too many cells to be copied into each of them
+	std::vector<Box> boxes;
+	std::vector<uint32_t> seenStamp;
+	uint32_t queryStamp = 0;
+public:
+	void Build(const std::vector<Box>& items); // items are referred to by their index in this vector
+	void Query(const Box& area, std::vector<size_t>& result); // appends indices of items intersecting area, each once, in ascending order
+	void Query(const Box& area, std::vector<size_t>& result, std::vector<char>& seen) const; // same, but safe for concurrent callers that each bring their own seen flags
+	const Box& Bounds() const; // union of all item boxes
+private:
+	int CellX(double x) const;
+	int CellY(double y) const;
+	template<typename Take>
+	void ForEachCandidate(const Box& area, Take take) const; // items of the cells area touches, plus long items; may repeat items
+};
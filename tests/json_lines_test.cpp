@@ -0,0 +1,91 @@
+// Parses generated JSON Lines text with Json::LoadLines in order and out of order, over small chunks and several thread
+// counts, and checks that every line arrives once with the right document and offset. Exits with 1 on a mismatch.
+#include "json.h"
+#include "json_lines.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+	constexpr int lineCount = 50000;
+
+	int failures = 0;
+
+	void Check(bool condition, const std::string& what) {
+		if (!condition) {
+			std::cerr << "FAILED: " << what << '\n';
+			++failures;
+		}
+	}
+
+	std::string MakeLines(std::vector<size_t>& offsets) { // line i is {"i": i, "s": "..."}, with a blank line now and then
+		std::string text;
+		for (int i = 0; i < lineCount; ++i) {
+			if (i % 1000 == 0) {
+				text += " \r\n";
+			}
+			offsets.push_back(text.size());
+			text += "{\"i\": " + std::to_string(i) + ", \"s\": \"" + std::string(i % 50, 'x') + "\"}\n";
+		}
+		return text;
+	}
+
+	void TestDelivery(const std::string& text, const std::vector<size_t>& offsets, bool isOrdered, size_t threadCount, size_t chunkSize) {
+		std::string name = std::string(isOrdered ? "ordered" : "unordered") + ", " + std::to_string(threadCount) + " threads, chunks of "
+			+ std::to_string(chunkSize);
+		Json::LinesOptions options;
+		options.ordered = isOrdered;
+		options.threadCount = threadCount;
+		options.chunkSize = chunkSize;
+		std::vector<int> seen(lineCount, 0);
+		std::vector<Json::Document> kept; // documents outlive the call and the chunk they were parsed in
+		bool isInOrder = true;
+		bool isMatching = true;
+		int previous = -1;
+		size_t count = Json::LoadLines(text, [&](size_t offset, Json::Document document) {
+			int i = document.GetRoot().AsMap().at("i").AsInt();
+			isMatching = isMatching && i >= 0 && i < lineCount && offsets[i] == offset;
+			isInOrder = isInOrder && i > previous;
+			previous = i;
+			++seen[i];
+			if (i % 997 == 0) {
+				kept.push_back(std::move(document));
+			}
+		}, options);
+		Check(count == lineCount, name + ": count");
+		Check(isMatching, name + ": offsets match the documents");
+		Check(std::count(seen.begin(), seen.end(), 1) == lineCount, name + ": every line once");
+		if (isOrdered) {
+			Check(isInOrder, name + ": file order");
+		}
+		bool isKeptIntact = true;
+		for (const auto& document : kept) {
+			int i = document.GetRoot().AsMap().at("i").AsInt();
+			isKeptIntact = isKeptIntact && document.GetRoot().AsMap().at("s").AsString().size() == static_cast<size_t>(i % 50);
+		}
+		Check(isKeptIntact, name + ": kept documents");
+	}
+}
+
+int main() {
+	std::vector<size_t> offsets;
+	std::string text = MakeLines(offsets);
+	for (bool isOrdered : { true, false }) {
+		for (size_t threadCount : { 1, 2, 0 }) {
+			for (size_t chunkSize : { 1, 4096, 1 << 20 }) {
+				TestDelivery(text, offsets, isOrdered, threadCount, chunkSize);
+			}
+		}
+	}
+	bool isRejected = false;
+	try {
+		Json::LoadLines(text + "{\"i\": 1,}\n", [](size_t, Json::Document) {});
+	} catch (const std::runtime_error&) {
+		isRejected = true;
+	}
+	Check(isRejected, "malformed line throws");
+	std::cout << (failures ? "json_lines_test: FAILED\n" : "json_lines_test: passed\n");
+	return failures ? 1 : 0;
+}
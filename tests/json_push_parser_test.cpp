@@ -0,0 +1,97 @@
+// Feeds every file of JSON_test_files to Json::PushParser in randomly sized pieces and compares the result with
+// Json::Load, then checks that malformed input leaves the parser failed until Reset. Run from the repository root;
+// exits with 1 on the first mismatch.
+#include "json.h"
+#include "json_push_parser.h"
+#include "json_writer.h"
+#include "mapped_file.h"
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+namespace {
+	constexpr int splitsPerFile = 20;
+	constexpr size_t maxPiece = 4096;
+
+	int failures = 0;
+
+	void Check(bool condition, const std::string& what) {
+		if (!condition) {
+			std::cerr << "FAILED: " << what << '\n';
+			++failures;
+		}
+	}
+
+	std::string Dump(const Json::Node& node) {
+		std::string text;
+		Json::Writer(text).Value(node);
+		return text;
+	}
+
+	void FeedInPieces(Json::PushParser& parser, std::string_view text, std::mt19937& random, size_t maxSize) {
+		std::uniform_int_distribution<size_t> pieceSize(1, maxSize);
+		while (!text.empty()) {
+			std::string_view piece = text.substr(0, pieceSize(random));
+			text.remove_prefix(piece.size());
+			while (!piece.empty() && !parser.IsDone()) {
+				piece.remove_prefix(parser.Feed(piece));
+			}
+		}
+	}
+
+	template<typename Exception, typename Action>
+	bool Throws(Action action) {
+		try {
+			action();
+		} catch (const Exception&) {
+			return true;
+		} catch (...) {
+			return false;
+		}
+		return false;
+	}
+
+	void TestSplits(const std::filesystem::path& path, std::mt19937& random) {
+		MappedFile file(path.string());
+		std::string_view text = file.View();
+		std::string expected = Dump(Json::Load(text).GetRoot());
+		for (int split = 0; split < splitsPerFile; ++split) {
+			Json::PushParser parser;
+			FeedInPieces(parser, text, random, split % 2 ? 16 : maxPiece); // tiny pieces cut most tokens
+			parser.Finish();
+			Check(parser.IsDone() && Dump(parser.TakeDocument().GetRoot()) == expected, path.string() + " split " + std::to_string(split));
+		}
+	}
+
+	void TestError(std::string_view text, std::mt19937& random) {
+		std::string name = "error in " + std::string(text);
+		Json::PushParser parser;
+		Check(Throws<std::runtime_error>([&]() {
+			FeedInPieces(parser, text, random, 3);
+			parser.Finish();
+		}), name + " throws");
+		Check(!parser.IsDone(), name + " is not done");
+		Check(Throws<std::logic_error>([&parser]() { parser.Feed("]"); }), name + ": Feed throws logic_error");
+		Check(Throws<std::logic_error>([&parser]() { parser.Finish(); }), name + ": Finish throws logic_error");
+		parser.Reset();
+		parser.Feed("[1, {\"a\": \"b\"}]");
+		Check(parser.IsDone() && Dump(parser.TakeDocument().GetRoot()) == "[1,{\"a\":\"b\"}]", name + ": parses again after Reset");
+	}
+}
+
+int main(int argc, char** argv) {
+	std::filesystem::path directory = argc > 1 ? argv[1] : "JSON_test_files";
+	std::mt19937 random(1);
+	for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+		if (entry.path().extension() == ".json") {
+			TestSplits(entry.path(), random);
+		}
+	}
+	for (std::string_view text : { "[1-2]", "[\"\\uZZZZ\"]", "-", "[1, 2 }", "[1,]", "{\"a\" 1}", "[tru]", "[\"open" }) {
+		TestError(text, random);
+	}
+	std::cout << (failures ? "json_push_parser_test: FAILED\n" : "json_push_parser_test: passed\n");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,171 @@
+#include "thread_pool.h"
+#include "alloc_tracking.h"
+#include "trace.h"
+#include <exception>
+
+namespace {
+	thread_local ThreadPool* currentPool = nullptr; // pool the current thread is a worker of
+	thread_local size_t currentQueue = 0;
+}
+
+ThreadPool::ThreadPool(size_t workerCount) {
+	for (size_t i = 0; i < workerCount; ++i) {
+		queues.push_back(std::make_unique<Queue>());
+	}
+	for (size_t i = 0; i < workerCount; ++i) {
+		workers.emplace_back(&ThreadPool::work, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		isStopping = true;
+	}
+	wakeUp.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+ThreadPool& ThreadPool::Shared() {
+	static ThreadPool pool{ std::max(1u, std::thread::hardware_concurrency()) - 1 };
+	return pool;
+}
+
+size_t ThreadPool::Concurrency() const {
+	return workers.size() + 1;
+}
+
+void ThreadPool::Submit(Task task, Priority priority) {
+	if (queues.empty()) {
+		task();
+		return;
+	}
+	size_t queue = currentPool == this ? currentQueue : nextQueue++ % queues.size(); // workers keep what they spawn, so it stays in their cache
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		++queuedCount;
+	}
+	{
+		std::lock_guard<std::mutex> guard(queues[queue]->lock);
+		queues[queue]->tasks[static_cast<size_t>(priority)].push_back(std::move(task));
+	}
+	wakeUp.notify_one();
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t grain, const RangeBody& body, size_t maxThreads, Priority priority) {
+	grain = grain ? grain : 1;
+	size_t rangeCount = (count + grain - 1) / grain;
+	size_t threads = threadsFor(rangeCount, maxThreads);
+	if (threads < 2) {
+		if (count > 0) {
+			body(0, count);
+		}
+		return;
+	}
+
+	std::atomic<size_t> nextRange{ 0 };
+	size_t pendingHelpers = threads - 1; // guarded by doneLock
+	std::mutex doneLock;
+	std::condition_variable done;
+	std::atomic<bool> hasFailed{ false };
+	std::exception_ptr error;
+	std::mutex errorLock;
+#ifdef ENABLE_ALLOC_TRACKING
+	AllocTracking::Subsystem subsystem = AllocTracking::Current(); // helpers charge their allocations to the caller's subsystem
+#endif
+	auto takeRanges = [&]() {
+		ALLOC_SCOPE(subsystem);
+		try {
+			for (size_t range = nextRange++; range < rangeCount && !hasFailed; range = nextRange++) {
+				body(range * grain, std::min(count, (range + 1) * grain));
+			}
+		} catch (...) {
+			std::lock_guard<std::mutex> guard(errorLock);
+			if (!error) {
+				error = std::current_exception();
+			}
+			hasFailed = true;
+		}
+	};
+	for (size_t i = 1; i < threads; ++i) {
+		Submit([&takeRanges, &pendingHelpers, &doneLock, &done]() {
+			takeRanges();
+			std::lock_guard<std::mutex> guard(doneLock); // notified under the lock, since the caller may return and destroy done once it sees 0
+			if (--pendingHelpers == 0) {
+				done.notify_one();
+			}
+		}, priority);
+	}
+	takeRanges();
+	// Helpers still queued behind other work are run here instead of being waited for. Lower priority tasks are left
+	// alone, since they could hold the loop up for as long as they take. Once nothing is left to run, every helper
+	// has been taken by a thread, so the caller sleeps until they are done.
+	while (true) {
+		{
+			std::lock_guard<std::mutex> guard(doneLock);
+			if (pendingHelpers == 0) {
+				break;
+			}
+		}
+		if (!runOne(priority)) {
+			std::unique_lock<std::mutex> guard(doneLock);
+			done.wait(guard, [&pendingHelpers]() { return pendingHelpers == 0; });
+			break;
+		}
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+size_t ThreadPool::threadsFor(size_t rangeCount, size_t maxThreads) const {
+	return std::min({ maxThreads ? maxThreads : Concurrency(), Concurrency(), rangeCount });
+}
+
+bool ThreadPool::runOne(Priority lowest) {
+	size_t home = currentPool == this ? currentQueue : 0;
+	for (size_t priority = 0; priority <= static_cast<size_t>(lowest); ++priority) {
+		for (size_t i = 0; i < queues.size(); ++i) {
+			size_t victim = (home + i) % queues.size();
+			bool isOwn = currentPool == this && victim == home;
+			Task task;
+			{
+				std::lock_guard<std::mutex> guard(queues[victim]->lock);
+				auto& tasks = queues[victim]->tasks[priority];
+				if (tasks.empty()) {
+					continue;
+				}
+				if (isOwn) {
+					task = std::move(tasks.back());
+					tasks.pop_back();
+				} else {
+					task = std::move(tasks.front());
+					tasks.pop_front();
+				}
+			}
+			--queuedCount;
+			TRACE_SCOPE("ThreadPool task");
+			task();
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::work(size_t index) {
+	currentPool = this;
+	currentQueue = index;
+	TRACE_THREAD_NAME("pool worker");
+	while (true) {
+		if (runOne()) {
+			continue;
+		}
+		std::unique_lock<std::mutex> guard(sleepLock);
+		wakeUp.wait(guard, [this]() { return isStopping || queuedCount > 0; });
+		if (isStopping && queuedCount == 0) {
+			return;
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+class ThreadPool { // work-stealing task scheduler: every worker has its own deques and takes from the others' when they run dry
+public:
+	enum class Priority {
+		High, // work a frame is waiting for
+		Normal,
+		Low // background work nobody is waiting for
+	};
+	using Task = std::function<void()>;
+	using RangeBody = std::function<void(size_t begin, size_t end)>;
+private:
+	static constexpr size_t priorityCount = 3;
+	struct Queue {
+		std::mutex lock;
+		std::deque<Task> tasks[priorityCount]; // the owner works at the back, thieves take from the front
+	};
+	std::vector<std::unique_ptr<Queue>> queues; // one per worker
+	std::vector<std::thread> workers;
+	std::mutex sleepLock;
+	std::condition_variable wakeUp;
+	std::atomic<size_t> queuedCount{ 0 }; // incremented under sleepLock, so sleeping workers cannot miss a task
+	std::atomic<size_t> nextQueue{ 0 }; // queue for the next task submitted from outside the pool
+	bool isStopping = false;
+public:
+	explicit ThreadPool(size_t workerCount);
+	~ThreadPool(); // runs what is still queued, then joins the workers
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	static ThreadPool& Shared(); // the application's pool, one worker per core besides the thread that waits for them
+	size_t Concurrency() const; // threads a parallel loop can use: the workers and the caller
+	void Submit(Task task, Priority priority = Priority::Normal); // runs inline when there are no workers
+	// Calls body on consecutive ranges of at most grain items until [0, count) is covered, on up to maxThreads
+	// threads (0 for all of them) including the caller, and returns when all ranges are done. The caller runs
+	// ranges and queued tasks of at least priority while it waits, then sleeps, so loops may nest. Rethrows the
+	// first exception body throws.
+	void ParallelFor(size_t count, size_t grain, const RangeBody& body, size_t maxThreads = 0, Priority priority = Priority::Normal);
+	// Folds map(begin, end) of every range with combine, in range order, so the result does not depend on the thread count.
+	template<typename T, typename Map, typename Combine>
+	T Reduce(size_t count, size_t grain, T identity, Map map, Combine combine, size_t maxThreads = 0, Priority priority = Priority::Normal);
+private:
+	size_t threadsFor(size_t rangeCount, size_t maxThreads) const; // threads a loop over rangeCount ranges runs on
+	bool runOne(Priority lowest = Priority::Low); // runs one queued task of at least priority lowest, highest priority first; false if there was none
+	void work(size_t index);
+};
+
+template<typename T, typename Map, typename Combine>
+T ThreadPool::Reduce(size_t count, size_t grain, T identity, Map map, Combine combine, size_t maxThreads, Priority priority) {
+	grain = grain ? grain : 1;
+	size_t rangeCount = (count + grain - 1) / grain;
+	if (threadsFor(rangeCount, maxThreads) < 2) { // same ranges in the same order, without storing partial results
+		T result = identity;
+		for (size_t range = 0; range < rangeCount; ++range) {
+			result = combine(result, map(range * grain, std::min(count, (range + 1) * grain)));
+		}
+		return result;
+	}
+	std::vector<T> partials(rangeCount, identity);
+	ParallelFor(rangeCount, 1, [&](size_t begin, size_t end) {
+		for (size_t range = begin; range < end; ++range) {
+			partials[range] = map(range * grain, std::min(count, (range + 1) * grain));
+		}
+	}, maxThreads, priority);
+	T result = identity;
+	for (auto& partial : partials) {
+		result = combine(result, partial);
+	}
+	return result;
+}
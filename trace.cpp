@@ -0,0 +1,113 @@
+#include "trace.h"
+#ifdef ENABLE_TRACE
+#include "json_writer.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+	constexpr size_t eventsPerThread = 1 << 18; // later events of a thread are counted but dropped
+
+	struct Event {
+		const char* name;
+		int64_t start; // nanoseconds since epoch
+		int64_t duration;
+	};
+
+	struct ThreadBuffer {
+		std::unique_ptr<Event[]> events{ new Event[eventsPerThread] };
+		std::atomic<size_t> count{ 0 }; // events before count are complete, published with release
+		std::atomic<size_t> dropped{ 0 };
+		std::atomic<const char*> name{ nullptr };
+		size_t id = 0;
+	};
+
+	const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	std::mutex registryLock; // guards buffers and output, never taken while recording
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers; // kept after their threads end, until the trace is written
+	std::string output = "trace.json";
+
+	ThreadBuffer& LocalBuffer() {
+		thread_local ThreadBuffer* buffer = nullptr;
+		if (!buffer) {
+			std::lock_guard<std::mutex> guard(registryLock);
+			buffers.push_back(std::make_unique<ThreadBuffer>());
+			buffer = buffers.back().get();
+			buffer->id = buffers.size();
+		}
+		return *buffer;
+	}
+
+	void WriteTrace() {
+		std::lock_guard<std::mutex> guard(registryLock);
+		std::string text;
+		size_t dropped = 0;
+		{
+			Json::Writer writer{ text };
+			writer.BeginObject().Key("displayTimeUnit").Value("ms").Key("traceEvents").BeginArray();
+			for (const auto& buffer : buffers) {
+				if (const char* name = buffer->name.load()) {
+					writer.BeginObject().Key("name").Value("thread_name").Key("ph").Value("M").Key("pid").Value(1).Key("tid").Value(buffer->id);
+					writer.Key("args").BeginObject().Key("name").Value(name).EndObject().EndObject();
+				}
+				size_t count = buffer->count.load(std::memory_order_acquire);
+				for (size_t i = 0; i < count; ++i) {
+					const Event& event = buffer->events[i];
+					writer.BeginObject().Key("name").Value(event.name).Key("ph").Value("X").Key("pid").Value(1).Key("tid").Value(buffer->id);
+					writer.Key("ts").Value(event.start / 1000.0).Key("dur").Value(event.duration / 1000.0).EndObject();
+				}
+				dropped += buffer->dropped;
+			}
+			writer.EndArray().EndObject();
+		}
+		std::ofstream file(output, std::ios::binary);
+		file << text;
+		if (!file) {
+			std::cerr << "cannot write trace to " << output << '\n';
+		}
+		if (dropped > 0) {
+			std::cerr << "trace: " << dropped << " events dropped, the buffers were full\n";
+		}
+	}
+
+	struct WriteAtExit { // defined after the buffers, so it is destroyed, and writes, before them
+		~WriteAtExit() {
+			WriteTrace();
+		}
+	} writeAtExit;
+}
+
+namespace Trace {
+	Scope::Scope(const char* name) :name{ name }, start{ std::chrono::steady_clock::now() } {
+	}
+
+	Scope::~Scope() {
+		Record(name, start, std::chrono::steady_clock::now());
+	}
+
+	void Record(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+		ThreadBuffer& buffer = LocalBuffer();
+		size_t count = buffer.count.load(std::memory_order_relaxed);
+		if (count == eventsPerThread) {
+			++buffer.dropped;
+			return;
+		}
+		auto nanoseconds = [](std::chrono::steady_clock::duration duration) { return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(); };
+		buffer.events[count] = { name, nanoseconds(start - epoch), nanoseconds(end - start) };
+		buffer.count.store(count + 1, std::memory_order_release);
+	}
+
+	void SetThreadName(const char* name) {
+		LocalBuffer().name = name;
+	}
+
+	void SetOutput(const std::string& filename) {
+		std::lock_guard<std::mutex> guard(registryLock);
+		output = filename;
+	}
+}
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+// Chrome trace instrumentation, compiled in only when ENABLE_TRACE is defined:
+//
+//     TRACE_SCOPE("Graph::Draw"); // times the rest of the enclosing block
+//     TRACE_SPAN("Graph::Draw lock wait", start, end); // records steady_clock times taken anyway
+//
+// Every thread records into a buffer of its own without locking. When the program exits the events are written
+// to trace.json (or the file given to Trace::SetOutput), which opens in chrome://tracing or ui.perfetto.dev.
+#ifdef ENABLE_TRACE
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace Trace {
+	class Scope {
+	private:
+		const char* name; // must outlive the program's end, e.g. a string literal
+		std::chrono::steady_clock::time_point start;
+	public:
+		explicit Scope(const char* name);
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+		~Scope();
+	};
+
+	void Record(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+	void SetThreadName(const char* name); // labels the calling thread's track
+	void SetOutput(const std::string& filename);
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__){ name }
+#define TRACE_SPAN(name, start, end) Trace::Record(name, start, end)
+#define TRACE_THREAD_NAME(name) Trace::SetThreadName(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_SPAN(name, start, end) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif